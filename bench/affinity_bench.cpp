@@ -0,0 +1,127 @@
+//!
+//! Compares thread placement policies on the in-process request path (InferenceService + CPU backend).
+//!
+//!   bench_affinity [--requests 20000] [--clients 4] [--preprocess 2] [--engine 2] [--policies "none;compact;scatter"]
+//!
+//! Client threads stand in for the HTTP I/O threads and are placed by the same policy, ahead of the
+//! preprocessing and engine pools, exactly as tensorrt_cpp_server does. Each client sends requests back to back.
+//!
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "bench.h"
+#include "cpu_mnist.h"
+#include "service.h"
+
+struct AffinityBenchParams {
+    int requests{20000};
+    int clients{4};
+    int preprocess{2};
+    int engine{2};
+    std::vector<std::string> policies{"none", "compact", "scatter"};
+};
+
+static bool parseArgs(int argc, char* argv[], AffinityBenchParams& params) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--requests") {
+            params.requests = std::stoi(value);
+        } else if (arg == "--clients") {
+            params.clients = std::stoi(value);
+        } else if (arg == "--preprocess") {
+            params.preprocess = std::stoi(value);
+        } else if (arg == "--engine") {
+            params.engine = std::stoi(value);
+        } else if (arg == "--policies") {
+            params.policies.clear();
+            std::stringstream ss(value);
+            std::string policy;
+            while (std::getline(ss, policy, ';')) {
+                params.policies.push_back(policy);
+            }
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && params.clients > 0;
+}
+
+int main(int argc, char* argv[]) {
+    AffinityBenchParams params;
+    if (!parseArgs(argc, argv, params)) {
+        std::cout << "Usage: bench_affinity [--requests <n>] [--clients <n>] [--preprocess <n>] [--engine <n>]\n"
+                     "                      [--policies none;compact;scatter;<cpu list>]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    CpuMnistApi model;
+    if (!model.load()) {
+        std::cerr << "Could not load mnist.onnx" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const auto topology = CpuTopology::detect();
+    std::cout << topology.cpus().size() << " CPUs on " << topology.nodeCount() << " NUMA node(s); " << params.clients
+              << " clients, " << params.preprocess << " preprocess, " << params.engine << " engine threads\n";
+    std::cout << std::left << std::setw(12) << "policy" << std::right << std::setw(12) << "req/s" << std::setw(12)
+              << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "p99.9 us" << std::endl;
+
+    const std::string pgm = syntheticPGM();
+    for (const auto& name : params.policies) {
+        PinConfig pin;
+        if (!parsePinConfig(name, pin)) {
+            std::cerr << "Bad policy " << name << std::endl;
+            return EXIT_FAILURE;
+        }
+        CorePlanner planner(topology, pin);
+        std::vector<int> clientCpus = planner.take(params.clients);
+        ServiceConfig config;
+        config.preprocessThreads = params.preprocess;
+        config.preprocessCpus = planner.take(params.preprocess);
+        config.engineThreads = params.engine;
+        config.engineCpus = planner.take(params.engine);
+        InferenceService service(model, config);
+
+        // Warm up the pools and caches.
+        for (int i = 0; i < 100; i++) {
+            service.classify(pgm);
+        }
+
+        std::atomic<int> next{0};
+        std::vector<std::vector<int64_t>> latencies(params.clients);
+        const int64_t start = nowNs();
+        std::vector<std::thread> clients;
+        for (int c = 0; c < params.clients; c++) {
+            clients.emplace_back([&, c]() {
+                if (!clientCpus.empty()) {
+                    pinCurrentThread(clientCpus[c]);
+                }
+                auto& lat = latencies[c];
+                while (next.fetch_add(1) < params.requests) {
+                    const int64_t t0 = nowNs();
+                    service.classify(pgm);
+                    lat.push_back(nowNs() - t0);
+                }
+            });
+        }
+        for (auto& t : clients) {
+            t.join();
+        }
+        const double seconds = (nowNs() - start) / 1e9;
+
+        std::vector<int64_t> all;
+        for (const auto& lat : latencies) {
+            all.insert(all.end(), lat.begin(), lat.end());
+        }
+        std::sort(all.begin(), all.end());
+        std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(12) << all.size() / seconds << std::setprecision(1) << std::setw(12)
+                  << percentile(all, 50) / 1e3 << std::setw(12) << percentile(all, 99) / 1e3 << std::setw(12)
+                  << percentile(all, 99.9) / 1e3 << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "timing.h"
+
+//!
+//! Helpers shared by the benchmarks in this directory.
+//!
+
+//!
+//! \brief A binary PGM image of the given size with a vertical bar, as uploaded by clients.
+//!
+inline std::string syntheticPGM(int h = 28, int w = 28) {
+    std::string pgm = "P5\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n";
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            pgm += static_cast<char>(x >= w / 2 - 1 && x <= w / 2 + 1 && y > 3 && y < h - 3 ? 0 : 255);
+        }
+    }
+    return pgm;
+}
+
+//!
+//! \brief A multipart/form-data body with the given fields, in order, as a browser or curl -F would send it.
+//!        Fields named "file" are sent as files.
+//!
+inline std::string multipartBody(
+    const std::string& boundary, const std::vector<std::pair<std::string, std::string>>& fields) {
+    std::string body;
+    for (const auto& field : fields) {
+        body += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + field.first + "\"";
+        if (field.first == "file") {
+            body += "; filename=\"digit.pgm\"\r\nContent-Type: application/octet-stream";
+        }
+        body += "\r\n\r\n" + field.second + "\r\n";
+    }
+    body += "--" + boundary + "--\r\n";
+    return body;
+}
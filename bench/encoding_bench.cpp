@@ -0,0 +1,96 @@
+//!
+//! Serialization cost and payload size of the response encodings for batches of 1 to 1024 items, each with a
+//! full probability vector.
+//!
+//!   bench_encoding [--iterations-scale 1.0]
+//!
+//! When crow is available the crow::json::wvalue DOM that the server used before is measured as a baseline.
+//!
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "bench.h"
+#include "encoding.h"
+#ifdef HAVE_CROW
+#include "crow.h"
+#endif
+
+static BatchResult makeBatch(size_t n, int classes) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> uniform(0.0F, 1.0F);
+    BatchResult result;
+    result.batch = true;
+    result.withProbabilities = true;
+    result.classes = classes;
+    for (size_t i = 0; i < n; i++) {
+        result.results.push_back(static_cast<int32_t>(rng() % classes));
+        result.status.push_back(i % 97 == 96 ? 1 : 0);
+        float sum = 0.0F;
+        for (int c = 0; c < classes; c++) {
+            result.probabilities.push_back(uniform(rng));
+            sum += result.probabilities.back();
+        }
+        for (int c = 0; c < classes; c++) {
+            result.probabilities[i * classes + c] /= sum;
+        }
+    }
+    return result;
+}
+
+#ifdef HAVE_CROW
+static void encodeCrowDom(const BatchResult& result, std::string& out) {
+    crow::json::wvalue json;
+    for (size_t i = 0; i < result.size(); i++) {
+        json["Results"][i] = result.results[i];
+        json["Status"][i] = result.status[i] == 0 ? 200 : 400;
+        for (int c = 0; c < result.classes; c++) {
+            json["Probabilities"][i][c] = result.probabilities[i * result.classes + c];
+        }
+    }
+    out = json.dump();
+}
+#endif
+
+template <typename Fn>
+static void measure(const char* name, size_t batch, double scale, Fn encode) {
+    std::string out;
+    encode(out); // warm up, and size the payload
+    const size_t bytes = out.size();
+    const int iterations = std::max(10, static_cast<int>(scale * 200000 / (batch + 8)));
+    const int64_t start = nowNs();
+    for (int i = 0; i < iterations; i++) {
+        out.clear();
+        encode(out);
+    }
+    const double ns = static_cast<double>(nowNs() - start) / iterations;
+    std::cout << std::left << std::setw(8) << batch << std::setw(16) << name << std::right << std::fixed
+              << std::setprecision(0) << std::setw(14) << ns << std::setprecision(1) << std::setw(12)
+              << ns / batch << std::setw(12) << bytes << std::setw(12) << static_cast<double>(bytes) / batch
+              << std::setprecision(0) << std::setw(12) << bytes / ns * 1e3 << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    double scale = 1.0;
+    if (argc == 3 && std::string(argv[1]) == "--iterations-scale") {
+        scale = std::stod(argv[2]);
+    } else if (argc != 1) {
+        std::cout << "Usage: bench_encoding [--iterations-scale <factor>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << std::left << std::setw(8) << "batch" << std::setw(16) << "encoding" << std::right << std::setw(14)
+              << "ns/op" << std::setw(12) << "ns/item" << std::setw(12) << "bytes" << std::setw(12) << "bytes/item"
+              << std::setw(12) << "MB/s" << std::endl;
+    for (size_t batch : {1, 4, 16, 64, 256, 1024}) {
+        const BatchResult result = makeBatch(batch, 10);
+#ifdef HAVE_CROW
+        measure("crow-dom", batch, scale, [&](std::string& out) { encodeCrowDom(result, out); });
+#endif
+        measure("json", batch, scale, [&](std::string& out) { encodeJSON(result, out); });
+        measure("msgpack", batch, scale, [&](std::string& out) { encodeMsgPack(result, out); });
+        measure("binary-f32", batch, scale, [&](std::string& out) { encodeBinary(result, false, out); });
+        measure("binary-f16", batch, scale, [&](std::string& out) { encodeBinary(result, true, out); });
+    }
+    return EXIT_SUCCESS;
+}
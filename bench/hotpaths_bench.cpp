@@ -0,0 +1,232 @@
+//!
+//! Microbenchmarks of the CPU work around an inference: PGM parsing, input normalization, softmax/argmax,
+//! locating the model file, response construction, host buffer management and multipart parsing, plus the whole
+//! of handleUpload when crow is available. None of it needs CUDA or TensorRT.
+//!
+//!   bench_hotpaths [--min-time-ms 300] [--filter pgm/] [--exclude crow/] [--json results.json]
+//!                  [--baseline bench/hotpaths_baseline.json] [--threshold 50] [--alloc-threshold 10]
+//!
+//! With --baseline the exit code is non-zero if any benchmark got slower, or allocates more, by more than the
+//! thresholds. The benchmarks that need crow are named crow/... and kept in their own baseline,
+//! bench/hotpaths_crow_baseline.json, since only crow builds can record them. Run from the repository root so
+//! that locateFile finds models/mnist.onnx.
+//!
+
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include "common.h"
+#include "encoding.h"
+#include "generic_buffer.h"
+#include "microbench.h"
+#include "mnist_io.h"
+#include "multipart.h"
+#include "pgm.h"
+#ifdef HAVE_CROW
+#include "handlers.h"
+#include "model.h"
+#endif
+
+namespace {
+
+//! Discards everything written to it, so that printing is measured without terminal I/O.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        return n;
+    }
+};
+
+//! HostAllocator that reports to the allocation counters, which only see operator new.
+class CountingHostAllocator {
+public:
+    bool operator()(void** ptr, size_t size) const {
+        microbench::countAllocation(size);
+        *ptr = malloc(size);
+        return *ptr != nullptr;
+    }
+};
+
+using CountingHostBuffer = GenericBuffer<CountingHostAllocator, HostFree>;
+
+const int kH = 28;
+const int kW = 28;
+const int kClasses = 10;
+
+void benchPGM(microbench::Runner& runner) {
+    const std::string pgm = syntheticPGM(kH, kW);
+    runner.run("pgm/parsePGMData", pgm.size(), [&]() {
+        auto data = parsePGMData(pgm);
+        microbench::doNotOptimize(data);
+    });
+    uint8_t pixels[kH * kW];
+    runner.run("pgm/decodePGM", pgm.size(), [&]() {
+        microbench::doNotOptimize(decodePGM(pgm, pixels, kH, kW));
+    });
+}
+
+void benchInput(microbench::Runner& runner) {
+    const std::string pgm = syntheticPGM(kH, kW);
+    uint8_t pixels[kH * kW];
+    decodePGM(pgm, pixels, kH, kW);
+    float input[kH * kW];
+    NullBuffer discard;
+    std::ostream null(&discard);
+    runner.run("input/normalize", sizeof(pixels), [&]() {
+        normalizeDigit(pixels, kH * kW, input);
+        microbench::doNotOptimize(input);
+    });
+    // Only with the tensorrt backend's print=1 debug option
+    runner.run("input/print", sizeof(pixels), [&]() { printDigit(null, pixels, kH, kW); });
+}
+
+void benchOutput(microbench::Runner& runner) {
+    const float logits[kClasses] = {-2.1F, 0.3F, 1.7F, -0.4F, 5.2F, 0.0F, -1.3F, 2.2F, 0.9F, -3.0F};
+    float values[kClasses];
+    NullBuffer discard;
+    std::ostream null(&discard);
+    runner.run("output/softmaxArgmax", sizeof(logits), [&]() {
+        memcpy(values, logits, sizeof(logits));
+        microbench::doNotOptimize(softmaxArgmax(values, kClasses));
+    });
+    runner.run("output/print", sizeof(logits), [&]() { printProbabilities(null, values, kClasses); });
+}
+
+void benchLocateFile(microbench::Runner& runner) {
+    const std::vector<std::string> dataDirs{"data/mnist/", "data/samples/mnist/", "models/"};
+    if (locateFile("mnist.onnx", dataDirs, false).empty()) {
+        return;
+    }
+    runner.run("locateFile/mnist.onnx", 0, [&]() {
+        auto path = locateFile("mnist.onnx", dataDirs, false);
+        microbench::doNotOptimize(path);
+    });
+}
+
+void benchJSON(microbench::Runner& runner) {
+    BatchResult single;
+    single.classes = kClasses;
+    single.results.push_back(7);
+    single.status.push_back(0);
+    BatchResult withProbabilities = single;
+    withProbabilities.withProbabilities = true;
+    withProbabilities.probabilities.assign(kClasses, 0.1F);
+    std::string out;
+    runner.run("json/upload", 0, [&]() {
+        out.clear();
+        encodeJSON(single, out);
+        microbench::doNotOptimize(out);
+    });
+    runner.run("json/upload-probabilities", 0, [&]() {
+        out.clear();
+        encodeJSON(withProbabilities, out);
+        microbench::doNotOptimize(out);
+    });
+    runner.run("json/upload-new-string", 0, [&]() {
+        std::string fresh;
+        encodeJSON(single, fresh);
+        microbench::doNotOptimize(fresh);
+    });
+}
+
+void benchBuffers(microbench::Runner& runner) {
+    const size_t elements = kH * kW;
+    runner.run("buffer/construct", elements * sizeof(float), [&]() {
+        CountingHostBuffer buffer(elements, nvinfer1::DataType::kFLOAT);
+        microbench::doNotOptimize(buffer.data());
+    });
+    runner.run("buffer/resize-grow", elements * sizeof(float), [&]() {
+        CountingHostBuffer buffer;
+        buffer.resize(elements);
+        microbench::doNotOptimize(buffer.data());
+    });
+    CountingHostBuffer reused(elements, nvinfer1::DataType::kFLOAT);
+    runner.run("buffer/resize-within-capacity", elements * sizeof(float), [&]() {
+        reused.resize(elements / 2);
+        reused.resize(elements);
+        microbench::doNotOptimize(reused.data());
+    });
+    runner.run("buffer/move", 0, [&]() {
+        CountingHostBuffer moved(std::move(reused));
+        reused = std::move(moved);
+        microbench::doNotOptimize(reused.data());
+    });
+}
+
+//! Finding the file part of an upload, as the handlers do before decoding it.
+void benchMultipart(microbench::Runner& runner) {
+    const std::string boundary = "----bench0123456789";
+    const std::string contentType = "multipart/form-data; boundary=" + boundary;
+    auto findFile = [&](const std::string& body) {
+        std::string_view found;
+        MultipartPart part;
+        const bool ok = multipartBoundary(contentType, found) && findMultipartPart(body, found, "file", part);
+        microbench::doNotOptimize(ok);
+        microbench::doNotOptimize(part.body);
+    };
+    const std::string one = multipartBody(boundary, {{"file", syntheticPGM(kH, kW)}});
+    runner.run("multipart/findFilePart", one.size(), [&]() { findFile(one); });
+    const std::string three
+        = multipartBody(boundary, {{"label", "7"}, {"source", "bench"}, {"file", syntheticPGM(kH, kW)}});
+    runner.run("multipart/findFilePart-3-parts", three.size(), [&]() { findFile(three); });
+}
+
+#ifdef HAVE_CROW
+//! handleUpload with the simulated backend answering immediately, so that the request handling is measured.
+void benchUpload(microbench::Runner& runner) {
+    auto model = createModel("sim:latency_us=0,per_item_us=0");
+    model->load();
+    InferenceService service(*model, ServiceConfig());
+    const std::string boundary = "----bench0123456789";
+    crow::request req;
+    req.add_header("Content-Type", "multipart/form-data; boundary=" + boundary);
+    req.body = multipartBody(boundary, {{"file", syntheticPGM(kH, kW)}});
+    runner.run("crow/handleUpload", req.body.size(), [&]() {
+        auto res = handleUpload(service, req);
+        microbench::doNotOptimize(res.body);
+    });
+    req.body = multipartBody(boundary, {{"label", "7"}, {"source", "bench"}, {"file", syntheticPGM(kH, kW)}});
+    runner.run("crow/handleUpload-3-parts", req.body.size(), [&]() {
+        auto res = handleUpload(service, req);
+        microbench::doNotOptimize(res.body);
+    });
+    runner.run("crow/multipart-message", req.body.size(), [&]() {
+        crow::multipart::message message(req);
+        microbench::doNotOptimize(message.part_map);
+    });
+
+    BatchResult result;
+    result.classes = kClasses;
+    result.results.push_back(7);
+    result.status.push_back(0);
+    runner.run("crow/encodeResponse", 0, [&]() {
+        auto res = encodeResponse(req, result);
+        microbench::doNotOptimize(res.body);
+    });
+}
+#endif
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    microbench::Options options;
+    if (!microbench::parseOptions(argc, argv, options)) {
+        std::cout << "Usage: bench_hotpaths " << microbench::usage() << std::endl;
+        return EXIT_FAILURE;
+    }
+    microbench::Runner runner(options);
+    benchPGM(runner);
+    benchInput(runner);
+    benchOutput(runner);
+    benchLocateFile(runner);
+    benchJSON(runner);
+    benchBuffers(runner);
+    benchMultipart(runner);
+#ifdef HAVE_CROW
+    benchUpload(runner);
+#endif
+    return runner.finish();
+}
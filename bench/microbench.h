@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bench.h"
+
+//!
+//! Harness for single-threaded microbenchmarks: time per operation, heap allocations per operation and
+//! throughput, with results saved as a JSON baseline and compared against one.
+//!
+//! Allocations are counted by the replacement operator new in count_allocations.cpp, which every target using
+//! this header links; code that allocates with malloc can report through countAllocation().
+//!
+
+namespace microbench {
+
+inline std::atomic<int64_t> gAllocations{0};
+inline std::atomic<int64_t> gAllocatedBytes{0};
+
+inline void countAllocation(size_t bytes) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+//!
+//! \brief Keeps the compiler from optimizing away a value the benchmark computes.
+//!
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct Result {
+    std::string name;
+    double nsPerOp{0};
+    double allocsPerOp{0};
+    double allocatedBytesPerOp{0};
+    double opsPerSecond{0};
+    double bytesPerSecond{0}; //!< Input processed per second, 0 when the benchmark has no natural byte count.
+};
+
+struct Options {
+    int minTimeMs{300};   //!< Measured time per benchmark, split across the repetitions.
+    int repetitions{15};  //!< ns/op is the median repetition, which a few disturbed ones do not move.
+    std::string filter;   //!< Only run benchmarks whose name contains this.
+    std::string exclude;  //!< Skip benchmarks whose name contains this.
+    std::string jsonPath; //!< Write the results here.
+    std::vector<std::string> baselinePaths; //!< Compared against all of them together.
+    double timeThreshold{50};  //!< Percent increase of ns/op counted as a regression; timing is noisy.
+    double allocThreshold{10}; //!< Percent increase of allocated bytes/op counted as a regression.
+};
+
+//!
+//! \brief Parses the options shared by all microbenchmarks. Returns false on an unknown option.
+//!
+inline bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--min-time-ms") {
+            options.minTimeMs = std::max(1, std::stoi(value));
+        } else if (arg == "--repetitions") {
+            options.repetitions = std::max(1, std::stoi(value));
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--exclude") {
+            options.exclude = value;
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else if (arg == "--baseline") {
+            options.baselinePaths.push_back(value);
+        } else if (arg == "--threshold") {
+            options.timeThreshold = std::stod(value);
+        } else if (arg == "--alloc-threshold") {
+            options.allocThreshold = std::stod(value);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline const char* usage() {
+    return "[--min-time-ms <ms>] [--repetitions <n>] [--filter <substring>] [--exclude <substring>]\n"
+           "       [--json <results file>] [--baseline <results file>]... [--threshold <time percent>]\n"
+           "       [--alloc-threshold <percent>]";
+}
+
+class Runner {
+public:
+    //!
+    //! \brief Reads the baselines up front, so that run() can re-measure a benchmark that looks slower than its
+    //!        baseline entry. A baseline that cannot be read fails finish().
+    //!
+    explicit Runner(const Options& options);
+
+    //!
+    //! \brief Measures fn, which performs one operation on inputBytes bytes of input (0 if not meaningful).
+    //!
+    template <typename Fn>
+    void run(const std::string& name, size_t inputBytes, Fn&& fn) {
+        if ((!mOptions.filter.empty() && name.find(mOptions.filter) == std::string::npos)
+            || (!mOptions.exclude.empty() && name.find(mOptions.exclude) != std::string::npos)) {
+            return;
+        }
+        fn(); // warm up caches and lazily initialized state
+
+        // Find an iteration count that takes about one repetition's share of the time
+        const int64_t targetNs = static_cast<int64_t>(mOptions.minTimeMs) * 1000000 / mOptions.repetitions;
+        int64_t iterations = 1;
+        for (;;) {
+            const int64_t start = nowNs();
+            for (int64_t i = 0; i < iterations; i++) {
+                fn();
+            }
+            const int64_t elapsed = nowNs() - start;
+            if (elapsed >= targetNs / 4 || iterations >= (int64_t(1) << 40)) {
+                iterations = std::max<int64_t>(1, iterations * targetNs / std::max<int64_t>(elapsed, 1));
+                break;
+            }
+            iterations *= 4;
+        }
+
+        Result result = measure(iterations, fn);
+        // A disturbance that lasts through all the repetitions moves the median too, but unlike a real
+        // regression it does not survive measuring again
+        const auto base = mBaseline.find(name);
+        const double timeLimit = 1.0 + mOptions.timeThreshold / 100.0;
+        for (int retry = 0; retry < kRetries && base != mBaseline.end()
+             && result.nsPerOp > base->second.nsPerOp * timeLimit;
+             retry++) {
+            const Result again = measure(iterations, fn);
+            if (again.nsPerOp < result.nsPerOp) {
+                result = again;
+            }
+        }
+        result.name = name;
+        result.opsPerSecond = 1e9 / result.nsPerOp;
+        result.bytesPerSecond = inputBytes * result.opsPerSecond;
+        print(result);
+        mResults.push_back(result);
+    }
+
+    //!
+    //! \brief Writes the JSON results and compares them with the baseline, as the options ask. Returns the exit
+    //!        code: non-zero if a file could not be used or a benchmark regressed.
+    //!
+    int finish() const;
+
+    const std::vector<Result>& results() const {
+        return mResults;
+    }
+
+private:
+    //! Times a benchmark that looks slower than its baseline entry up to this many more times.
+    static constexpr int kRetries = 2;
+
+    template <typename Fn>
+    Result measure(int64_t iterations, Fn& fn) const {
+        std::vector<double> nsPerOp;
+        int64_t allocations = 0;
+        int64_t allocatedBytes = 0;
+        for (int r = 0; r < mOptions.repetitions; r++) {
+            const int64_t allocationsBefore = gAllocations.load();
+            const int64_t bytesBefore = gAllocatedBytes.load();
+            const int64_t start = nowNs();
+            for (int64_t i = 0; i < iterations; i++) {
+                fn();
+            }
+            nsPerOp.push_back(static_cast<double>(nowNs() - start) / iterations);
+            allocations += gAllocations.load() - allocationsBefore;
+            allocatedBytes += gAllocatedBytes.load() - bytesBefore;
+        }
+
+        Result result;
+        std::nth_element(nsPerOp.begin(), nsPerOp.begin() + nsPerOp.size() / 2, nsPerOp.end());
+        result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+        const double ops = static_cast<double>(iterations) * mOptions.repetitions;
+        result.allocsPerOp = allocations / ops;
+        result.allocatedBytesPerOp = allocatedBytes / ops;
+        return result;
+    }
+
+    static void print(const Result& result) {
+        std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << result.nsPerOp << std::setprecision(2) << std::setw(12) << result.allocsPerOp
+                  << std::setprecision(0) << std::setw(12) << result.allocatedBytesPerOp << std::setw(14)
+                  << result.opsPerSecond << std::setprecision(1) << std::setw(12) << result.bytesPerSecond / 1e6
+                  << std::endl;
+    }
+
+    Options mOptions;
+    std::vector<Result> mBaselineResults;     //!< All baselines together, in file order.
+    std::map<std::string, Result> mBaseline;  //!< mBaselineResults by name.
+    std::string mUnreadableBaseline;          //!< First baseline that could not be read, if any.
+    std::vector<Result> mResults;
+};
+
+inline bool writeResults(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << "{\n  \"benchmarks\": [\n" << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.nsPerOp
+            << ", \"allocs_per_op\": " << r.allocsPerOp << ", \"allocated_bytes_per_op\": " << r.allocatedBytesPerOp
+            << ", \"ops_per_second\": " << r.opsPerSecond << ", \"bytes_per_second\": " << r.bytesPerSecond << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+//!
+//! \brief Reads a file written by writeResults(). Only that layout is understood: one object per benchmark with
+//!        a string "name" and numeric fields.
+//!
+inline bool readResults(const std::string& path, std::vector<Result>& results) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string text = buffer.str();
+    results.clear();
+    for (size_t pos = text.find("\"name\""); pos != std::string::npos; pos = text.find("\"name\"", pos)) {
+        const size_t end = text.find('}', pos);
+        const size_t open = text.find('"', text.find(':', pos));
+        const size_t close = text.find('"', open + 1);
+        if (end == std::string::npos || close == std::string::npos || close > end) {
+            return false;
+        }
+        Result r;
+        r.name = text.substr(open + 1, close - open - 1);
+        auto number = [&](const char* key) {
+            const size_t at = text.find(std::string("\"") + key + "\"", pos);
+            return at < end ? std::strtod(text.c_str() + text.find(':', at) + 1, nullptr) : 0.0;
+        };
+        r.nsPerOp = number("ns_per_op");
+        r.allocsPerOp = number("allocs_per_op");
+        r.allocatedBytesPerOp = number("allocated_bytes_per_op");
+        r.opsPerSecond = number("ops_per_second");
+        r.bytesPerSecond = number("bytes_per_second");
+        results.push_back(r);
+        pos = end;
+    }
+    return true;
+}
+
+//!
+//! \brief Prints how each result changed from the baseline and returns the number of failures: ns/op up by more
+//!        than timeThreshold percent, allocated bytes/op up by more than allocThreshold percent (or an
+//!        allocation where there was none), or a benchmark the baseline does not have, since nothing would
+//!        check it.
+//!
+inline int compareResults(const std::vector<Result>& results, const std::vector<Result>& baseline,
+    double timeThreshold, double allocThreshold, std::ostream& out) {
+    std::map<std::string, const Result*> byName;
+    for (const auto& r : baseline) {
+        byName[r.name] = &r;
+    }
+    const double timeLimit = 1.0 + timeThreshold / 100.0;
+    const double allocLimit = 1.0 + allocThreshold / 100.0;
+    int regressions = 0;
+    int missing = 0;
+    out << "\nCompared with the baseline (thresholds " << timeThreshold << "% time, " << allocThreshold
+        << "% allocated bytes):" << std::endl;
+    for (const auto& r : results) {
+        auto it = byName.find(r.name);
+        if (it == byName.end()) {
+            out << "  " << std::left << std::setw(40) << r.name << "MISSING FROM THE BASELINE" << std::endl;
+            missing++;
+            continue;
+        }
+        const Result& b = *it->second;
+        byName.erase(it);
+        const double time = b.nsPerOp > 0 ? r.nsPerOp / b.nsPerOp : 1.0;
+        const bool slower = time > timeLimit;
+        const bool allocates = r.allocatedBytesPerOp > b.allocatedBytesPerOp * allocLimit + 0.5;
+        const bool regressed = slower || allocates;
+        regressions += regressed;
+        out << "  " << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(8) << (time - 1.0) * 100 << "% time, " << std::setprecision(0) << std::setw(8)
+            << b.allocatedBytesPerOp << " -> " << r.allocatedBytesPerOp << " bytes/op"
+            << (regressed ? "  REGRESSION" : time < 1.0 / timeLimit ? "  improved" : "") << std::endl;
+    }
+    for (const auto& unmatched : byName) {
+        out << "  " << std::left << std::setw(40) << unmatched.first << "in the baseline but not run" << std::endl;
+    }
+    out << regressions << " regression" << (regressions == 1 ? "" : "s");
+    if (missing > 0) {
+        out << ", " << missing << " benchmark" << (missing == 1 ? "" : "s")
+            << " missing from the baseline: regenerate it with --json on this build";
+    }
+    out << std::endl;
+    return regressions + missing;
+}
+
+inline Runner::Runner(const Options& options)
+    : mOptions(options)
+{
+    for (const auto& path : mOptions.baselinePaths) {
+        std::vector<Result> results;
+        if (!readResults(path, results)) {
+            mUnreadableBaseline = path;
+            break;
+        }
+        mBaselineResults.insert(mBaselineResults.end(), results.begin(), results.end());
+    }
+    for (const auto& r : mBaselineResults) {
+        mBaseline[r.name] = r;
+    }
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(12) << "ns/op"
+              << std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op" << std::setw(14) << "ops/s"
+              << std::setw(12) << "MB/s" << std::endl;
+}
+
+inline int Runner::finish() const {
+    int status = EXIT_SUCCESS;
+    if (!mOptions.jsonPath.empty()) {
+        if (writeResults(mOptions.jsonPath, mResults)) {
+            std::cout << "Results written to " << mOptions.jsonPath << std::endl;
+        } else {
+            std::cout << "Could not write " << mOptions.jsonPath << std::endl;
+            status = EXIT_FAILURE;
+        }
+    }
+    if (!mUnreadableBaseline.empty()) {
+        std::cout << "Could not read the baseline " << mUnreadableBaseline << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!mOptions.baselinePaths.empty()
+        && compareResults(mResults, mBaselineResults, mOptions.timeThreshold, mOptions.allocThreshold, std::cout)
+            > 0) {
+        status = EXIT_FAILURE;
+    }
+    return status;
+}
+
+} // namespace microbench
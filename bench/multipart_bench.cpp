@@ -0,0 +1,96 @@
+//!
+//! Cost of finding the "file" part of a multipart/form-data upload with 1 to 20 parts and a file of 1 KB to
+//! 10 MB, placed after the other fields (or first, for "file-first").
+//!
+//!   bench_multipart [--min-time-ms 200] [--filter stream/] [--json results.json] [--baseline <file>]
+//!
+//! "stream" is MultipartReader as the handlers use it. "copy" walks the same parts but copies each one's headers
+//! and body into a multimap, the copies crow::multipart::message makes for its part_map. When crow is available
+//! "crow" measures crow::multipart::message itself, the path the handlers used before.
+//!
+
+#include <map>
+#include <random>
+#include "microbench.h"
+#include "multipart.h"
+#ifdef HAVE_CROW
+#include "crow.h"
+#endif
+
+namespace {
+
+const char kBoundary[] = "----FormBoundary7MA4YWxkTrZu0gW";
+
+std::string randomBytes(size_t size) {
+    std::mt19937 rng(7);
+    std::string bytes(size, '\0');
+    for (auto& b : bytes) {
+        b = static_cast<char>(rng());
+    }
+    return bytes;
+}
+
+std::string sizeName(size_t bytes) {
+    return bytes >= (1 << 20) ? std::to_string(bytes >> 20) + "MB" : std::to_string(bytes >> 10) + "KB";
+}
+
+void benchCase(microbench::Runner& runner, int parts, size_t fileBytes, bool fileFirst) {
+    std::vector<std::pair<std::string, std::string>> fields;
+    for (int i = 0; i + 1 < parts; i++) {
+        fields.emplace_back("field" + std::to_string(i), std::string(32, static_cast<char>('a' + i % 26)));
+    }
+    fields.insert(fileFirst ? fields.begin() : fields.end(), {"file", randomBytes(fileBytes)});
+    const std::string body = multipartBody(kBoundary, fields);
+    const std::string contentType = std::string("multipart/form-data; boundary=") + kBoundary;
+    const std::string suffix = "/" + std::to_string(parts) + "p/" + sizeName(fileBytes) + (fileFirst ? "/file-first" : "");
+
+    runner.run("stream" + suffix, body.size(), [&]() {
+        std::string_view boundary;
+        MultipartPart part;
+        const bool found = multipartBoundary(contentType, boundary) && findMultipartPart(body, boundary, "file", part);
+        microbench::doNotOptimize(found);
+        microbench::doNotOptimize(part.body);
+    });
+
+    runner.run("copy" + suffix, body.size(), [&]() {
+        std::string_view boundary;
+        multipartBoundary(contentType, boundary);
+        std::multimap<std::string, std::pair<std::string, std::string>> partMap;
+        MultipartReader reader(body, boundary);
+        MultipartPart part;
+        while (reader.next(part)) {
+            partMap.emplace(std::string(part.name()), std::make_pair(std::string(part.headers), std::string(part.body)));
+        }
+        auto file = partMap.find("file");
+        microbench::doNotOptimize(file->second.second);
+    });
+
+#ifdef HAVE_CROW
+    crow::request req;
+    req.add_header("Content-Type", contentType);
+    req.body = body;
+    runner.run("crow" + suffix, body.size(), [&]() {
+        crow::multipart::message message(req);
+        auto file = message.part_map.find("file");
+        microbench::doNotOptimize(file->second.body);
+    });
+#endif
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    microbench::Options options;
+    if (!microbench::parseOptions(argc, argv, options)) {
+        std::cout << "Usage: bench_multipart " << microbench::usage() << std::endl;
+        return EXIT_FAILURE;
+    }
+    microbench::Runner runner(options);
+    for (size_t fileBytes : {size_t(1) << 10, size_t(64) << 10, size_t(1) << 20, size_t(10) << 20}) {
+        for (int parts : {1, 5, 20}) {
+            benchCase(runner, parts, fileBytes, false);
+        }
+        benchCase(runner, 20, fileBytes, true);
+    }
+    return runner.finish();
+}
@@ -0,0 +1,256 @@
+#include "affinity.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+int readInt(const std::string& path, int fallback) {
+    std::ifstream file(path);
+    int value;
+    return (file >> value) ? value : fallback;
+}
+
+//!
+//! \brief Parses a kernel style CPU list ("0-3,8,10-11").
+//!
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::stringstream ss(text);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        try {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
+
+} // namespace
+
+CpuTopology CpuTopology::detect() {
+    namespace fs = std::filesystem;
+    CpuTopology topology;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &allowed);
+        }
+    }
+
+    const long configured = sysconf(_SC_NPROCESSORS_CONF);
+    std::map<std::tuple<int, int>, int> siblings; // (package, core) -> threads seen so far
+    for (int cpu = 0; cpu < configured && cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        CpuInfo info;
+        info.id = cpu;
+        info.package = readInt(base + "/topology/physical_package_id", 0);
+        info.core = readInt(base + "/topology/core_id", cpu);
+        info.node = 0;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(base, ec)) {
+            const std::string name = entry.path().filename().string();
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 && isdigit(name[4])) {
+                info.node = std::stoi(name.substr(4));
+                break;
+            }
+        }
+        info.thread = siblings[std::make_tuple(info.package, info.core)]++;
+        topology.mCpus.push_back(info);
+    }
+    if (topology.mCpus.empty()) {
+        topology.mCpus.push_back(CpuInfo{0, 0, 0, 0, 0});
+    }
+    return topology;
+}
+
+int CpuTopology::nodeCount() const {
+    int nodes = 0;
+    for (const auto& cpu : mCpus) {
+        nodes = std::max(nodes, cpu.node + 1);
+    }
+    return nodes;
+}
+
+int CpuTopology::nodeOf(int cpu) const {
+    for (const auto& info : mCpus) {
+        if (info.id == cpu) {
+            return info.node;
+        }
+    }
+    return 0;
+}
+
+bool parsePinConfig(const std::string& text, PinConfig& config) {
+    config.cpus.clear();
+    if (text == "none") {
+        config.policy = PinPolicy::kNONE;
+    } else if (text == "compact") {
+        config.policy = PinPolicy::kCOMPACT;
+    } else if (text == "scatter") {
+        config.policy = PinPolicy::kSCATTER;
+    } else {
+        config.policy = PinPolicy::kLIST;
+        return parseCpuList(text, config.cpus);
+    }
+    return true;
+}
+
+std::string toString(const PinConfig& config) {
+    switch (config.policy) {
+    case PinPolicy::kNONE: return "none";
+    case PinPolicy::kCOMPACT: return "compact";
+    case PinPolicy::kSCATTER: return "scatter";
+    case PinPolicy::kLIST: break;
+    }
+    std::string list;
+    for (int cpu : config.cpus) {
+        list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return list;
+}
+
+CorePlanner::CorePlanner(const CpuTopology& topology, const PinConfig& config) {
+    std::vector<CpuInfo> cpus = topology.cpus();
+    switch (config.policy) {
+    case PinPolicy::kNONE:
+        return;
+    case PinPolicy::kLIST:
+        mOrder = config.cpus;
+        return;
+    case PinPolicy::kCOMPACT:
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            return std::tie(a.node, a.package, a.core, a.thread) < std::tie(b.node, b.package, b.core, b.thread);
+        });
+        break;
+    case PinPolicy::kSCATTER: {
+        // Rank each core within its node, then order by (sibling, rank, node): every physical core on every
+        // node is used once before any hyperthread sibling, and consecutive threads alternate nodes.
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+            return std::tie(a.node, a.package, a.core, a.thread) < std::tie(b.node, b.package, b.core, b.thread);
+        });
+        std::map<int, std::map<std::tuple<int, int>, int>> coreRank;
+        std::vector<int> rank(cpus.size());
+        for (size_t i = 0; i < cpus.size(); i++) {
+            auto& ranks = coreRank[cpus[i].node];
+            auto key = std::make_tuple(cpus[i].package, cpus[i].core);
+            auto it = ranks.find(key);
+            if (it == ranks.end()) {
+                it = ranks.emplace(key, static_cast<int>(ranks.size())).first;
+            }
+            rank[i] = it->second;
+        }
+        std::vector<size_t> idx(cpus.size());
+        for (size_t i = 0; i < idx.size(); i++) {
+            idx[i] = i;
+        }
+        std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+            return std::make_tuple(cpus[a].thread, rank[a], cpus[a].node)
+                < std::make_tuple(cpus[b].thread, rank[b], cpus[b].node);
+        });
+        std::vector<CpuInfo> ordered;
+        for (size_t i : idx) {
+            ordered.push_back(cpus[i]);
+        }
+        cpus.swap(ordered);
+        break;
+    }
+    }
+    for (const auto& cpu : cpus) {
+        mOrder.push_back(cpu.id);
+    }
+}
+
+std::vector<int> CorePlanner::take(int count) {
+    std::vector<int> cpus;
+    if (mOrder.empty()) {
+        return cpus;
+    }
+    for (int i = 0; i < count; i++) {
+        cpus.push_back(mOrder[mNext++ % mOrder.size()]);
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(int cpu) {
+    return restrictCurrentThread({cpu});
+}
+
+bool restrictCurrentThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+LocalBuffer::LocalBuffer(size_t size) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    mSize = (size + page - 1) / page * page;
+    mData = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mData == MAP_FAILED) {
+        mData = nullptr;
+        mSize = 0;
+        throw std::bad_alloc();
+    }
+    // First touch from this thread.
+    for (size_t offset = 0; offset < mSize; offset += page) {
+        static_cast<volatile char*>(mData)[offset] = 0;
+    }
+}
+
+LocalBuffer::~LocalBuffer() {
+    if (mData) {
+        munmap(mData, mSize);
+    }
+}
+
+LocalBuffer::LocalBuffer(LocalBuffer&& other) noexcept
+    : mData(other.mData)
+    , mSize(other.mSize)
+{
+    other.mData = nullptr;
+    other.mSize = 0;
+}
+
+LocalBuffer& LocalBuffer::operator=(LocalBuffer&& other) noexcept {
+    if (this != &other) {
+        if (mData) {
+            munmap(mData, mSize);
+        }
+        mData = other.mData;
+        mSize = other.mSize;
+        other.mData = nullptr;
+        other.mSize = 0;
+    }
+    return *this;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//!
+//! \brief One logical CPU as seen in /sys/devices/system/cpu.
+//!
+struct CpuInfo {
+    int id;      //!< Logical CPU number, as used by sched_setaffinity.
+    int node;    //!< NUMA node.
+    int package; //!< Physical socket.
+    int core;    //!< Physical core id within the package.
+    int thread;  //!< Index among the hyperthread siblings of the core (0 for the first).
+};
+
+//!
+//! \brief The CPUs this process is allowed to run on, with their socket/core/NUMA placement.
+//!
+class CpuTopology {
+public:
+    //!
+    //! \brief Reads the topology from sysfs, restricted to the process affinity mask. Falls back to a flat
+    //!        single-node layout when sysfs is not available.
+    //!
+    static CpuTopology detect();
+
+    const std::vector<CpuInfo>& cpus() const {
+        return mCpus;
+    }
+
+    int nodeCount() const;
+
+    //!
+    //! \brief NUMA node of a logical CPU, or 0 if unknown.
+    //!
+    int nodeOf(int cpu) const;
+
+private:
+    std::vector<CpuInfo> mCpus;
+};
+
+enum class PinPolicy {
+    kNONE,    //!< Leave placement to the scheduler.
+    kCOMPACT, //!< Fill hyperthread siblings, then cores, then sockets: keeps cooperating threads close.
+    kSCATTER, //!< One thread per physical core, round-robin across sockets: maximizes cache and bandwidth.
+    kLIST,    //!< Explicit CPU list, used in order.
+};
+
+struct PinConfig {
+    PinPolicy policy{PinPolicy::kNONE};
+    std::vector<int> cpus; //!< For kLIST.
+};
+
+//!
+//! \brief Parses "none", "compact", "scatter" or a CPU list such as "0-3,8,10-11".
+//!
+bool parsePinConfig(const std::string& text, PinConfig& config);
+
+std::string toString(const PinConfig& config);
+
+//!
+//! \brief Hands out CPUs to thread pools in policy order, so that pools created one after another get disjoint
+//!        cores as long as there are enough of them (and wrap around when there are not).
+//!
+class CorePlanner {
+public:
+    CorePlanner(const CpuTopology& topology, const PinConfig& config);
+
+    //!
+    //! \brief Returns the CPUs for the next count threads, or an empty list for PinPolicy::kNONE.
+    //!
+    std::vector<int> take(int count);
+
+private:
+    std::vector<int> mOrder;
+    size_t mNext{0};
+};
+
+//!
+//! \brief Pins the calling thread to one CPU. Returns false if the CPU is not available.
+//!
+bool pinCurrentThread(int cpu);
+
+//!
+//! \brief Restricts the calling thread to a set of CPUs. Threads it creates afterwards inherit the mask.
+//!
+bool restrictCurrentThread(const std::vector<int>& cpus);
+
+//!
+//! \brief Page-aligned buffer whose pages are faulted in by the constructing thread.
+//!
+//! Linux places anonymous pages on the NUMA node of the thread that first touches them, so a buffer created
+//! by a thread after it has been pinned is local to that thread's node.
+//!
+class LocalBuffer {
+public:
+    LocalBuffer() = default;
+    explicit LocalBuffer(size_t size);
+    ~LocalBuffer();
+
+    LocalBuffer(LocalBuffer&& other) noexcept;
+    LocalBuffer& operator=(LocalBuffer&& other) noexcept;
+    LocalBuffer(const LocalBuffer&) = delete;
+    LocalBuffer& operator=(const LocalBuffer&) = delete;
+
+    void* data() {
+        return mData;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+private:
+    void* mData{nullptr};
+    size_t mSize{0};
+};
@@ -0,0 +1,369 @@
+//!
+//! Finds the batching and concurrency settings for the in-process request path.
+//!
+//!   tensorrt_cpp_autotune (--rate <req/s> | --slo-ms <p99 ms>) [--backend <spec>] [--duration-ms 1000]
+//!                         [--max-instances <n>] [--max-workers <n>] [--rounds <n>] [--output tuned.conf]
+//!
+//! Each trial builds an InferenceService with one candidate configuration and drives it from a pool of worker
+//! threads standing in for the HTTP threads:
+//!
+//!   --rate      open loop: requests arrive at the given rate, and latency is measured from the scheduled
+//!               arrival, so queueing counts. A configuration qualifies when it keeps up with the rate (and meets
+//!               --slo-ms if also given); the lowest p99 wins.
+//!   --slo-ms    closed loop: every worker sends back-to-back requests, which is how a server with that many
+//!               HTTP threads behaves under overload. A configuration qualifies when its p99 is within the SLO;
+//!               the highest throughput wins.
+//!
+//! The search runs a coarse grid, then moves to the best neighbouring configuration (batch and workers doubled
+//! or halved, delay doubled or halved, instances +-1) until no neighbour is better. The winner is written in the
+//! format the server reads with --config.
+//!
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model.h"
+#include "service.h"
+#include "thread_pool.h"
+#include "timing.h"
+#include "tuning.h"
+
+struct AutotuneParams {
+    std::string backend{kDefaultBackend};
+    double rate{0};  //!< Target request rate, 0 for closed-loop SLO mode.
+    double sloMs{0}; //!< p99 latency limit, 0 for none.
+    int durationMs{1000};
+    int maxInstances{static_cast<int>(std::max(1U, std::thread::hardware_concurrency()))};
+    int maxWorkers{256};
+    int rounds{8};
+    std::string output{"tuned.conf"};
+};
+
+struct Trial {
+    double throughput{0}; //!< Completed requests per second.
+    double p50Ms{0};
+    double p99Ms{0};
+    bool feasible{false};
+};
+
+class Autotuner {
+public:
+    explicit Autotuner(const AutotuneParams& params)
+        : mParams(params)
+    {
+        // Random digits-sized images; the cost of the backends does not depend on the content
+        std::mt19937 rng(7);
+        for (int i = 0; i < 16; i++) {
+            std::string pgm = "P5\n28 28\n255\n";
+            for (int p = 0; p < InferenceService::kInputH * InferenceService::kInputW; p++) {
+                pgm += static_cast<char>(rng() & 0xff);
+            }
+            mImages.push_back(pgm);
+        }
+    }
+
+    //!
+    //! \brief Makes sure count model instances are loaded.
+    //!
+    bool loadInstances(int count) {
+        while (static_cast<int>(mModels.size()) < count) {
+            auto model = createModel(mParams.backend);
+            if (!model || !model->load()) {
+                std::cout << "Failed to create a " << mParams.backend << " model" << std::endl;
+                return false;
+            }
+            mModels.push_back(std::move(model));
+        }
+        return true;
+    }
+
+    //!
+    //! \brief Measures config, after clamping it to the search limits. Results are cached per configuration.
+    //!
+    const Trial* measure(TunedConfig& config) {
+        normalize(config);
+        auto found = mTrials.find(config);
+        if (found != mTrials.end()) {
+            return &found->second;
+        }
+        if (!loadInstances(config.instances)) {
+            return nullptr;
+        }
+        std::vector<Model*> instances;
+        for (int i = 0; i < config.instances; i++) {
+            instances.push_back(mModels[i].get());
+        }
+        ServiceConfig serviceConfig;
+        serviceConfig.maxBatch = config.maxBatch;
+        serviceConfig.batchDelayUs = config.batchDelayUs;
+        InferenceService service(instances, serviceConfig);
+
+        std::vector<int64_t> latencies;
+        const double seconds = mParams.rate > 0 ? openLoop(service, config.ioThreads, latencies)
+                                                : closedLoop(service, config.ioThreads, latencies);
+        std::sort(latencies.begin(), latencies.end());
+
+        Trial trial;
+        const size_t completed = std::lower_bound(latencies.begin(), latencies.end(), INT64_MAX) - latencies.begin();
+        trial.throughput = seconds > 0 ? completed / seconds : 0;
+        trial.p50Ms = percentile(latencies, 50) / 1e6;
+        trial.p99Ms = percentile(latencies, 99) / 1e6;
+        trial.feasible = (mParams.sloMs <= 0 || trial.p99Ms <= mParams.sloMs)
+            && (mParams.rate <= 0 || (completed == latencies.size() && trial.throughput >= 0.95 * mParams.rate));
+
+        std::cout << std::left << std::setw(64) << config.toString() << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(10) << trial.throughput << std::setprecision(3)
+                  << std::setw(10) << trial.p50Ms << std::setw(10) << trial.p99Ms << (trial.feasible ? "  ok" : "")
+                  << std::endl;
+        return &mTrials.emplace(config, trial).first->second;
+    }
+
+    //!
+    //! \brief True if a is a better result than b for the target.
+    //!
+    bool better(const Trial& a, const Trial& b) const {
+        if (a.feasible != b.feasible) {
+            return a.feasible;
+        }
+        const bool lowerLatency = a.p99Ms < b.p99Ms;
+        const bool higherThroughput = a.throughput > b.throughput;
+        if (mParams.rate > 0) {
+            return a.feasible ? lowerLatency : higherThroughput;
+        }
+        return a.feasible ? higherThroughput : lowerLatency;
+    }
+
+    std::vector<TunedConfig> neighbours(const TunedConfig& config) const {
+        std::vector<TunedConfig> result;
+        auto add = [&](TunedConfig candidate) {
+            normalize(candidate);
+            if (!(candidate < config) && !(config < candidate)) {
+                return;
+            }
+            result.push_back(candidate);
+        };
+        TunedConfig c = config;
+        c.maxBatch = config.maxBatch * 2;
+        add(c);
+        c.maxBatch = std::max(1, config.maxBatch / 2);
+        add(c);
+        c = config;
+        c.batchDelayUs = config.batchDelayUs == 0 ? 250 : config.batchDelayUs * 2;
+        add(c);
+        c.batchDelayUs = config.batchDelayUs < 250 ? 0 : config.batchDelayUs / 2;
+        add(c);
+        c = config;
+        c.instances = config.instances + 1;
+        add(c);
+        c.instances = config.instances - 1;
+        add(c);
+        c = config;
+        c.ioThreads = config.ioThreads * 2;
+        add(c);
+        c.ioThreads = config.ioThreads / 2;
+        add(c);
+        return result;
+    }
+
+private:
+    //! Clamps to the search limits and drops settings that have no effect.
+    void normalize(TunedConfig& config) const {
+        config.maxBatch = std::min(std::max(1, config.maxBatch), 1024);
+        config.instances = std::min(std::max(1, config.instances), mParams.maxInstances);
+        config.ioThreads = std::min(std::max(1, config.ioThreads), mParams.maxWorkers);
+        config.batchDelayUs = config.maxBatch == 1 ? 0 : std::min<int64_t>(config.batchDelayUs, 100000);
+    }
+
+    //! Requests arrive at mParams.rate and are queued to the workers. Returns the measured span in seconds;
+    //! latencies of requests that were dropped because the run overran are INT64_MAX.
+    double openLoop(InferenceService& service, int workers, std::vector<int64_t>& latencies) {
+        const size_t total = std::max<size_t>(1, static_cast<size_t>(mParams.rate * mParams.durationMs / 1000));
+        const int64_t intervalNs = static_cast<int64_t>(1e9 / mParams.rate);
+        const int64_t cutoffNs = 3LL * mParams.durationMs * 1000000;
+        latencies.assign(total, INT64_MAX);
+        std::atomic<int64_t> lastDone{0};
+        ThreadPool pool(workers);
+        std::vector<std::future<void>> done;
+        done.reserve(total);
+        const int64_t start = nowNs() + 1000000;
+        for (size_t i = 0; i < total; i++) {
+            const int64_t scheduled = start + static_cast<int64_t>(i) * intervalNs;
+            std::this_thread::sleep_for(std::chrono::nanoseconds(scheduled - nowNs()));
+            done.push_back(pool.submit([&, i, scheduled, start]() {
+                if (nowNs() - start > cutoffNs) {
+                    return;
+                }
+                service.classify(mImages[i % mImages.size()]);
+                const int64_t end = nowNs();
+                latencies[i] = end - scheduled;
+                int64_t last = lastDone.load();
+                while (end > last && !lastDone.compare_exchange_weak(last, end)) {
+                }
+            }));
+        }
+        for (auto& f : done) {
+            f.get();
+        }
+        return lastDone > start ? (lastDone - start) / 1e9 : 0;
+    }
+
+    //! Every worker sends requests back to back for the duration.
+    double closedLoop(InferenceService& service, int workers, std::vector<int64_t>& latencies) {
+        std::vector<std::vector<int64_t>> perWorker(workers);
+        const int64_t start = nowNs();
+        const int64_t end = start + static_cast<int64_t>(mParams.durationMs) * 1000000;
+        std::vector<std::thread> threads;
+        for (int w = 0; w < workers; w++) {
+            threads.emplace_back([&, w]() {
+                for (size_t i = w;; i++) {
+                    const int64_t t0 = nowNs();
+                    if (t0 >= end) {
+                        break;
+                    }
+                    service.classify(mImages[i % mImages.size()]);
+                    perWorker[w].push_back(nowNs() - t0);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const double seconds = (nowNs() - start) / 1e9;
+        latencies.clear();
+        for (const auto& samples : perWorker) {
+            latencies.insert(latencies.end(), samples.begin(), samples.end());
+        }
+        return seconds;
+    }
+
+    AutotuneParams mParams;
+    std::vector<std::string> mImages;
+    std::vector<std::unique_ptr<Model>> mModels;
+    std::map<TunedConfig, Trial> mTrials;
+};
+
+static void usage() {
+    std::cout << "Usage: tensorrt_cpp_autotune (--rate <req/s> | --slo-ms <p99 ms>) [--backend <spec>]\n"
+                 "                             [--duration-ms <ms>] [--max-instances <n>] [--max-workers <n>]\n"
+                 "                             [--rounds <n>] [--output <file>]"
+              << std::endl;
+}
+
+static bool parseArgs(int argc, char* argv[], AutotuneParams& params) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rate" && hasValue) {
+            params.rate = std::stod(argv[++i]);
+        } else if (arg == "--slo-ms" && hasValue) {
+            params.sloMs = std::stod(argv[++i]);
+        } else if (arg == "--backend" && hasValue) {
+            params.backend = argv[++i];
+        } else if (arg == "--duration-ms" && hasValue) {
+            params.durationMs = std::max(10, std::stoi(argv[++i]));
+        } else if (arg == "--max-instances" && hasValue) {
+            params.maxInstances = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--max-workers" && hasValue) {
+            params.maxWorkers = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--rounds" && hasValue) {
+            params.rounds = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--output" && hasValue) {
+            params.output = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return params.rate > 0 || params.sloMs > 0;
+}
+
+int main(int argc, char* argv[]) {
+    AutotuneParams params;
+    if (!parseArgs(argc, argv, params)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    Autotuner tuner(params);
+    if (!tuner.loadInstances(1)) {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Tuning " << params.backend << " for "
+              << (params.rate > 0 ? "lowest p99 at " + std::to_string(static_cast<int>(params.rate)) + " req/s"
+                                  : std::string("highest throughput"))
+              << (params.sloMs > 0 ? " with p99 <= " + std::to_string(params.sloMs) + " ms" : std::string())
+              << "\n\n"
+              << std::left << std::setw(64) << "configuration" << std::right << std::setw(10) << "req/s"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::endl;
+
+    // Coarse grid
+    TunedConfig best;
+    const Trial* bestTrial = nullptr;
+    for (int maxBatch : {1, 8, 32}) {
+        for (int64_t delayUs : {0, 1000}) {
+            for (int instances : {1, 2, 4}) {
+                for (int workers : {4, 16, 64}) {
+                    TunedConfig config{maxBatch, delayUs, instances, workers};
+                    const Trial* trial = tuner.measure(config);
+                    if (!trial) {
+                        return EXIT_FAILURE;
+                    }
+                    if (!bestTrial || tuner.better(*trial, *bestTrial)) {
+                        best = config;
+                        bestTrial = trial;
+                    }
+                }
+            }
+        }
+    }
+
+    // Local refinement around the best configuration
+    for (int round = 0; round < params.rounds; round++) {
+        std::cout << "-- refining " << best.toString() << std::endl;
+        bool moved = false;
+        for (TunedConfig& config : tuner.neighbours(best)) {
+            const Trial* trial = tuner.measure(config);
+            if (!trial) {
+                return EXIT_FAILURE;
+            }
+            if (tuner.better(*trial, *bestTrial)) {
+                best = config;
+                bestTrial = trial;
+                moved = true;
+            }
+        }
+        if (!moved) {
+            break;
+        }
+    }
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(0) << "tensorrt_cpp_autotune --backend " << params.backend;
+    if (params.rate > 0) {
+        summary << " --rate " << params.rate;
+    }
+    if (params.sloMs > 0) {
+        summary << std::setprecision(3) << " --slo-ms " << params.sloMs;
+    }
+    summary << "\n" << std::setprecision(0) << bestTrial->throughput << " req/s, p50 " << std::setprecision(3)
+            << bestTrial->p50Ms << " ms, p99 " << bestTrial->p99Ms << " ms";
+    std::cout << "\nBest: " << best.toString() << "\n" << summary.str().substr(summary.str().find('\n') + 1)
+              << std::endl;
+    if (!bestTrial->feasible) {
+        std::cout << "Warning: no configuration met the target; writing the closest one" << std::endl;
+    }
+    if (!writeTunedConfig(params.output, best, summary.str())) {
+        std::cout << "Cannot write " << params.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Wrote " << params.output << std::endl;
+    return bestTrial->feasible ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,136 @@
+#include "batcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "affinity.h"
+
+namespace {
+
+int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+DynamicBatcher::DynamicBatcher(std::vector<Model*> instances, int maxBatch, int64_t delayUs, std::vector<int> cpus)
+    : mMaxBatch(std::max(1, maxBatch))
+    , mDelayUs(std::max<int64_t>(0, delayUs))
+    , mInputSize(instances.empty() ? 0 : static_cast<size_t>(instances[0]->inputSize()))
+    , mClasses(instances.empty() ? 0 : instances[0]->classCount())
+{
+    for (size_t i = 0; i < instances.size(); i++) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        mThreads.emplace_back(&DynamicBatcher::run, this, instances[i], cpu);
+    }
+}
+
+DynamicBatcher::~DynamicBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mQueued.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void DynamicBatcher::submit(Request* requests, int count) {
+    int pending = count;
+    std::condition_variable done;
+    std::unique_lock<std::mutex> lock(mMutex);
+    const int64_t arrival = nowUs();
+    for (int i = 0; i < count; i++) {
+        requests[i].arrivalUs = arrival;
+        requests[i].pending = &pending;
+        requests[i].done = &done;
+        mQueue.push_back(requests[i]);
+    }
+    // A thread collecting a batch waits on the same condition as the idle ones, so once a batch is complete
+    // all of them are woken to make sure the collecting one is among them.
+    if (mQueue.size() >= static_cast<size_t>(mMaxBatch) || count > 1) {
+        mQueued.notify_all();
+    } else {
+        mQueued.notify_one();
+    }
+    done.wait(lock, [&pending]() { return pending == 0; });
+}
+
+int DynamicBatcher::infer(const uint8_t* input, float* probabilities) {
+    int result = -1;
+    Request request{input, probabilities, &result, 0, nullptr, nullptr};
+    submit(&request, 1);
+    return result;
+}
+
+void DynamicBatcher::inferMany(const uint8_t* inputs, int count, int* results, float* probabilities) {
+    if (count <= 0 || mThreads.empty()) {
+        return;
+    }
+    std::vector<Request> requests(count);
+    for (int i = 0; i < count; i++) {
+        requests[i] = {inputs + i * mInputSize, probabilities ? probabilities + static_cast<size_t>(i) * mClasses : nullptr,
+            results + i, 0, nullptr, nullptr};
+    }
+    submit(requests.data(), count);
+}
+
+void DynamicBatcher::run(Model* model, int cpu) {
+    if (cpu >= 0) {
+        pinCurrentThread(cpu);
+    }
+    std::vector<uint8_t> batch(mMaxBatch * mInputSize);
+    std::vector<int> results(mMaxBatch);
+    std::vector<Request> taken;
+    taken.reserve(mMaxBatch);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mQueued.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+        if (mQueue.empty()) {
+            return;
+        }
+        if (mDelayUs > 0) {
+            const auto deadline = std::chrono::steady_clock::time_point(
+                std::chrono::microseconds(mQueue.front().arrivalUs + mDelayUs));
+            mQueued.wait_until(lock, deadline, [this]() {
+                return mStop || mQueue.empty() || mQueue.size() >= static_cast<size_t>(mMaxBatch);
+            });
+            if (mQueue.empty()) {
+                continue; // taken by another instance
+            }
+        }
+        const size_t n = std::min(mQueue.size(), static_cast<size_t>(mMaxBatch));
+        taken.assign(mQueue.begin(), mQueue.begin() + n);
+        mQueue.erase(mQueue.begin(), mQueue.begin() + n);
+        lock.unlock();
+
+        // Model::inferBatch does not return probabilities, so batches that need them run item by item
+        const bool anyProbabilities
+            = std::any_of(taken.begin(), taken.end(), [](const Request& r) { return r.probabilities != nullptr; });
+        if (anyProbabilities || n == 1) {
+            for (const auto& request : taken) {
+                const char* input = reinterpret_cast<const char*>(request.input);
+                *request.result
+                    = request.probabilities ? model->inferProbabilities(input, request.probabilities) : model->infer(input);
+            }
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                memcpy(batch.data() + i * mInputSize, taken[i].input, mInputSize);
+            }
+            model->inferBatch(reinterpret_cast<const char*>(batch.data()), static_cast<int>(n), results.data());
+            for (size_t i = 0; i < n; i++) {
+                *taken[i].result = results[i];
+            }
+        }
+
+        lock.lock();
+        for (const auto& request : taken) {
+            if (--*request.pending == 0) {
+                request.done->notify_one();
+            }
+        }
+    }
+}
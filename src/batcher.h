@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "model.h"
+
+//!
+//! \brief Groups concurrent requests into batches for one or more model instances.
+//!
+//! Each instance is driven by its own thread. A thread takes the oldest queued request and waits up to
+//! delayUs after its arrival for more to come in, then runs everything it has (at most maxBatch) as one batch.
+//! With delayUs = 0 only the requests already queued are batched together.
+//!
+class DynamicBatcher {
+public:
+    //!
+    //! \param instances Loaded models, one thread each. All must take the same input size.
+    //! \param cpus CPU per instance thread (cpus[i % cpus.size()]); empty leaves placement to the scheduler.
+    //!
+    DynamicBatcher(std::vector<Model*> instances, int maxBatch, int64_t delayUs, std::vector<int> cpus = {});
+    ~DynamicBatcher();
+
+    DynamicBatcher(const DynamicBatcher&) = delete;
+    DynamicBatcher& operator=(const DynamicBatcher&) = delete;
+
+    //!
+    //! \brief Classifies one input of the models' input size, blocking until its batch has run. When
+    //!        probabilities is not null it receives the class probabilities.
+    //!
+    int infer(const uint8_t* input, float* probabilities = nullptr);
+
+    //!
+    //! \brief Classifies count contiguous inputs; they are queued together and may be spread over instances.
+    //!        probabilities, when not null, receives count * classCount() values.
+    //!
+    void inferMany(const uint8_t* inputs, int count, int* results, float* probabilities = nullptr);
+
+private:
+    struct Request {
+        const uint8_t* input;
+        float* probabilities;
+        int* result;
+        int64_t arrivalUs;
+        int* pending;                 //!< Unfinished requests of the submitting call.
+        std::condition_variable* done; //!< Signalled when pending reaches 0.
+    };
+
+    void submit(Request* requests, int count);
+    void run(Model* model, int cpu);
+
+    int mMaxBatch;
+    int64_t mDelayUs;
+    size_t mInputSize;
+    int mClasses;
+    std::mutex mMutex;
+    std::condition_variable mQueued;
+    std::deque<Request> mQueue;
+    bool mStop{false};
+    std::vector<std::thread> mThreads;
+};
@@ -4,6 +4,7 @@
 #include <numeric>
 #include <unordered_map>
 #include <assert.h>
+#include "generic_buffer.h"
 
 #undef CHECK
 #define CHECK(status)                                                                                                  \
@@ -40,148 +41,6 @@
         }                                                                                                              \
     } while (0)
     
-template <typename A, typename B>
-inline A divUp(A x, B n) {
-    return (x + n - 1) / n;
-}
-
-inline int64_t volume(nvinfer1::Dims const& d) {
-    return std::accumulate(d.d, d.d + d.nbDims, int64_t{1}, std::multiplies<int64_t>{});
-}
-
-inline uint32_t getElementSize(nvinfer1::DataType t) noexcept {
-    switch (t) {
-    case nvinfer1::DataType::kINT64: return 8;
-    case nvinfer1::DataType::kINT32:
-    case nvinfer1::DataType::kFLOAT: return 4;
-    case nvinfer1::DataType::kBF16:
-    case nvinfer1::DataType::kHALF: return 2;
-    case nvinfer1::DataType::kBOOL:
-    case nvinfer1::DataType::kUINT8:
-    case nvinfer1::DataType::kINT8:
-    case nvinfer1::DataType::kFP8: return 1;
-    //case nvinfer1::DataType::kINT4: ASSERT(false && "Element size is not implemented for sub-byte data-types (INT4)");
-    }
-    return 0;
-}
-
-template <typename AllocFunc, typename FreeFunc>
-class GenericBuffer {
-public:
-    //!
-    //! \brief Construct an empty buffer.
-    //!
-    GenericBuffer(nvinfer1::DataType type = nvinfer1::DataType::kFLOAT)
-        : mSize(0)
-        , mCapacity(0)
-        , mType(type)
-        , mBuffer(nullptr)
-    {
-    }
-
-    //!
-    //! \brief Construct a buffer with the specified allocation size in bytes.
-    //!
-    GenericBuffer(size_t size, nvinfer1::DataType type)
-        : mSize(size)
-        , mCapacity(size)
-        , mType(type)
-    {
-        if (!allocFn(&mBuffer, this->nbBytes())) {
-            throw std::bad_alloc();
-        }
-    }
-
-    GenericBuffer(GenericBuffer&& buf)
-        : mSize(buf.mSize)
-        , mCapacity(buf.mCapacity)
-        , mType(buf.mType)
-        , mBuffer(buf.mBuffer)
-    {
-        buf.mSize = 0;
-        buf.mCapacity = 0;
-        buf.mType = nvinfer1::DataType::kFLOAT;
-        buf.mBuffer = nullptr;
-    }
-
-    GenericBuffer& operator=(GenericBuffer&& buf)
-    {
-        if (this != &buf) {
-            freeFn(mBuffer);
-            mSize = buf.mSize;
-            mCapacity = buf.mCapacity;
-            mType = buf.mType;
-            mBuffer = buf.mBuffer;
-            // Reset buf.
-            buf.mSize = 0;
-            buf.mCapacity = 0;
-            buf.mBuffer = nullptr;
-        }
-        return *this;
-    }
-
-    //!
-    //! \brief Returns pointer to underlying array.
-    //!
-    void* data() {
-        return mBuffer;
-    }
-
-    //!
-    //! \brief Returns pointer to underlying array.
-    //!
-    const void* data() const {
-        return mBuffer;
-    }
-
-    //!
-    //! \brief Returns the size (in number of elements) of the buffer.
-    //!
-    size_t size() const {
-        return mSize;
-    }
-
-    //!
-    //! \brief Returns the size (in bytes) of the buffer.
-    //!
-    size_t nbBytes() const {
-        return this->size() * getElementSize(mType);
-    }
-
-    //!
-    //! \brief Resizes the buffer. This is a no-op if the new size is smaller than or equal to the current capacity.
-    //!
-    void resize(size_t newSize) {
-        mSize = newSize;
-        if (mCapacity < newSize) {
-            freeFn(mBuffer);
-            if (!allocFn(&mBuffer, this->nbBytes())) {
-                throw std::bad_alloc{};
-            }
-            mCapacity = newSize;
-        }
-    }
-
-    //!
-    //! \brief Overload of resize that accepts Dims
-    //!
-    void resize(const nvinfer1::Dims& dims) {
-        return this->resize(volume(dims));
-    }
-
-    ~GenericBuffer() {
-        freeFn(mBuffer);
-    }
-
-private:
-    size_t mSize{0}, mCapacity{0};
-    nvinfer1::DataType mType;
-    void* mBuffer;
-    AllocFunc allocFn;
-    FreeFunc freeFn;
-};
-
-
 class DeviceAllocator {
 public:
     bool operator()(void** ptr, size_t size) const {
@@ -196,23 +55,7 @@ public:
     }
 };
 
-class HostAllocator {
-public:
-    bool operator()(void** ptr, size_t size) const {
-        *ptr = malloc(size);
-        return *ptr != nullptr;
-    }
-};
-
-class HostFree {
-public:
-    void operator()(void* ptr) const {
-        free(ptr);
-    }
-};
-
 using DeviceBuffer = GenericBuffer<DeviceAllocator, DeviceFree>;
-using HostBuffer = GenericBuffer<HostAllocator, HostFree>;
 
 class ManagedBuffer {
 public:
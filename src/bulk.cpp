@@ -0,0 +1,381 @@
+//!
+//! Offline bulk inference over MNIST IDX files or directories of PGM images.
+//!
+//!   tensorrt_cpp_bulk --images <t10k-images-idx3-ubyte | directory> [--labels <t10k-labels-idx1-ubyte>]
+//!                     [--backend cpu|tensorrt] [--batch 256] [--threads <n>] [--output <file>] [--format csv|binary]
+//!
+//! Images are decoded by a pool of threads into one of two batch buffers while the model runs on the other, so
+//! decoding overlaps inference. Predictions are written in input order. The binary format is one little-endian
+//! int32 per image (-1 for images that could not be decoded).
+//!
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "idx.h"
+#include "model.h"
+#include "pgm.h"
+
+namespace fs = std::filesystem;
+
+static const int kImageH = 28;
+static const int kImageW = 28;
+
+struct BulkParams {
+    std::string images;
+    std::string labels;
+    std::string backend{kDefaultBackend};
+    std::string output;
+    std::string format; //!< "csv" or "binary"; derived from the output extension when empty.
+    int batchSize{256};
+    int threads{static_cast<int>(std::max(1U, std::thread::hardware_concurrency()))};
+};
+
+//!
+//! \brief A random-access collection of labelled (or unlabelled) images.
+//!
+class ImageSource {
+public:
+    virtual ~ImageSource() = default;
+    virtual size_t size() const = 0;
+    //! Decodes image i into out (kImageH * kImageW bytes, PGM polarity: dark digit on light background).
+    virtual bool decode(size_t i, uint8_t* out) const = 0;
+    //! Ground truth for image i, or -1 if unknown.
+    virtual int label(size_t i) const = 0;
+    virtual std::string name(size_t i) const {
+        return std::to_string(i);
+    }
+};
+
+//!
+//! \brief MNIST IDX images, optionally with an IDX label file.
+//!
+class IdxImageSource : public ImageSource {
+public:
+    bool open(const std::string& images, const std::string& labels) {
+        if (!mImages.open(images)) {
+            return false;
+        }
+        if (mImages.dims().size() != 3 || mImages.dims()[1] != kImageH || mImages.dims()[2] != kImageW) {
+            std::cerr << images << " does not contain " << kImageH << "x" << kImageW << " images" << std::endl;
+            return false;
+        }
+        if (!labels.empty()) {
+            if (!mLabels.open(labels)) {
+                return false;
+            }
+            if (mLabels.dims().size() != 1 || mLabels.count() != mImages.count()) {
+                std::cerr << labels << " does not match " << images << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t size() const override {
+        return mImages.count();
+    }
+
+    bool decode(size_t i, uint8_t* out) const override {
+        // IDX stores light digits on a dark background; the model expects the PGM polarity.
+        const uint8_t* in = mImages.item(i);
+        for (int p = 0; p < kImageH * kImageW; p++) {
+            out[p] = static_cast<uint8_t>(255 - in[p]);
+        }
+        return true;
+    }
+
+    int label(size_t i) const override {
+        return mLabels.count() ? *mLabels.item(i) : -1;
+    }
+
+private:
+    IdxFile mImages;
+    IdxFile mLabels;
+};
+
+//!
+//! \brief Every .pgm file below a directory, in sorted order.
+//!
+//! Labels follow the usual layouts: a parent directory named after the digit (`<dir>/3/xxx.pgm`) or the
+//! TensorRT sample naming (`3.pgm`).
+//!
+class PgmDirectorySource : public ImageSource {
+public:
+    bool open(const std::string& dir) {
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator();
+             it.increment(ec)) {
+            if (it->is_regular_file() && it->path().extension() == ".pgm") {
+                mFiles.push_back(it->path());
+            }
+        }
+        if (ec) {
+            std::cerr << "Could not read " << dir << ": " << ec.message() << std::endl;
+            return false;
+        }
+        std::sort(mFiles.begin(), mFiles.end());
+        for (const auto& file : mFiles) {
+            mLabels.push_back(labelFor(file));
+        }
+        return true;
+    }
+
+    size_t size() const override {
+        return mFiles.size();
+    }
+
+    bool decode(size_t i, uint8_t* out) const override {
+        return readPGMFile(mFiles[i].string(), out, kImageH, kImageW);
+    }
+
+    int label(size_t i) const override {
+        return mLabels[i];
+    }
+
+    std::string name(size_t i) const override {
+        return mFiles[i].string();
+    }
+
+private:
+    static int labelFor(const fs::path& file) {
+        auto isDigit = [](const std::string& s) { return s.size() == 1 && s[0] >= '0' && s[0] <= '9'; };
+        const std::string parent = file.parent_path().filename().string();
+        if (isDigit(parent)) {
+            return parent[0] - '0';
+        }
+        const std::string stem = file.stem().string();
+        if (isDigit(stem)) {
+            return stem[0] - '0';
+        }
+        return -1;
+    }
+
+    std::vector<fs::path> mFiles;
+    std::vector<int> mLabels;
+};
+
+//!
+//! \brief One of the two buffers the decoder and the model alternate on.
+//!
+struct Batch {
+    std::vector<uint8_t> pixels;
+    std::vector<int> labels;
+    std::vector<int> results;
+    std::vector<char> valid;
+    size_t first{0};
+    int count{0};
+    bool ready{false}; //!< Decoded and waiting for the model.
+};
+
+//!
+//! \brief Splits [0, count) across threads and runs fn(begin, end) on each part.
+//!
+template <typename Fn>
+static void parallelFor(int count, int threads, Fn fn) {
+    threads = std::max(1, std::min(threads, count));
+    std::vector<std::thread> workers;
+    const int chunk = (count + threads - 1) / threads;
+    for (int t = 1; t < threads; t++) {
+        int begin = t * chunk;
+        if (begin < count) {
+            workers.emplace_back(fn, begin, std::min(count, begin + chunk));
+        }
+    }
+    fn(0, std::min(count, chunk));
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+static void usage() {
+    std::cout << "Usage: tensorrt_cpp_bulk --images <idx file | directory> [--labels <idx file>]\n"
+                 "                         [--backend cpu|tensorrt] [--batch <n>] [--threads <n>]\n"
+                 "                         [--output <file>] [--format csv|binary]"
+              << std::endl;
+}
+
+static bool parseArgs(int argc, char* argv[], BulkParams& params) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (arg == "--images") {
+            params.images = argv[++i];
+        } else if (arg == "--labels") {
+            params.labels = argv[++i];
+        } else if (arg == "--backend") {
+            params.backend = argv[++i];
+        } else if (arg == "--batch") {
+            params.batchSize = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--threads") {
+            params.threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--output") {
+            params.output = argv[++i];
+        } else if (arg == "--format") {
+            params.format = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    if (params.format.empty()) {
+        params.format = fs::path(params.output).extension() == ".csv" ? "csv" : "binary";
+    }
+    return !params.images.empty() && (params.format == "csv" || params.format == "binary");
+}
+
+int main(int argc, char* argv[]) {
+    BulkParams params;
+    if (!parseArgs(argc, argv, params)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<ImageSource> source;
+    if (fs::is_directory(params.images)) {
+        auto dir = std::make_unique<PgmDirectorySource>();
+        if (!dir->open(params.images)) {
+            return EXIT_FAILURE;
+        }
+        source = std::move(dir);
+    } else {
+        auto idx = std::make_unique<IdxImageSource>();
+        if (!idx->open(params.images, params.labels)) {
+            return EXIT_FAILURE;
+        }
+        source = std::move(idx);
+    }
+
+    auto model = createModel(params.backend, params.threads);
+    if (!model) {
+        std::cerr << "Unknown backend " << params.backend << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!model->load()) {
+        std::cerr << "Failed to load model" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (model->inputSize() != kImageH * kImageW) {
+        std::cerr << "Model expects " << model->inputSize() << " byte inputs" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream out;
+    if (!params.output.empty()) {
+        out.open(params.output, params.format == "csv" ? std::ios::out : std::ios::out | std::ios::binary);
+        if (!out) {
+            std::cerr << "Could not open " << params.output << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (params.format == "csv") {
+            out << "image,prediction,label\n";
+        }
+    }
+
+    const size_t total = source->size();
+    const int imageSize = kImageH * kImageW;
+    Batch batches[2];
+    for (auto& b : batches) {
+        b.pixels.resize(static_cast<size_t>(params.batchSize) * imageSize);
+        b.labels.resize(params.batchSize);
+        b.results.resize(params.batchSize);
+        b.valid.resize(params.batchSize);
+    }
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Decoder: fills the next free buffer while the model works on the other one.
+    std::thread prefetcher([&]() {
+        size_t next = 0;
+        for (size_t n = 0; next < total; n++) {
+            Batch& b = batches[n % 2];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&b]() { return !b.ready; });
+            }
+            b.first = next;
+            b.count = static_cast<int>(std::min<size_t>(params.batchSize, total - next));
+            parallelFor(b.count, params.threads, [&b, &source, imageSize](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    uint8_t* dst = b.pixels.data() + static_cast<size_t>(i) * imageSize;
+                    b.valid[i] = source->decode(b.first + i, dst);
+                    if (!b.valid[i]) {
+                        memset(dst, 255, imageSize);
+                    }
+                    b.labels[i] = source->label(b.first + i);
+                }
+            });
+            next += b.count;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                b.ready = true;
+            }
+            cv.notify_all();
+        }
+    });
+
+    size_t processed = 0, labelled = 0, correct = 0, failed = 0;
+    for (size_t n = 0; processed < total; n++) {
+        Batch& b = batches[n % 2];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&b]() { return b.ready; });
+        }
+        model->inferBatch(reinterpret_cast<const char*>(b.pixels.data()), b.count, b.results.data());
+
+        for (int i = 0; i < b.count; i++) {
+            if (!b.valid[i]) {
+                b.results[i] = -1;
+                failed++;
+            } else if (b.labels[i] >= 0) {
+                labelled++;
+                correct += b.results[i] == b.labels[i];
+            }
+        }
+        if (out.is_open()) {
+            if (params.format == "csv") {
+                for (int i = 0; i < b.count; i++) {
+                    out << source->name(b.first + i) << ',' << b.results[i] << ',';
+                    if (b.labels[i] >= 0) {
+                        out << b.labels[i];
+                    }
+                    out << '\n';
+                }
+            } else {
+                out.write(reinterpret_cast<const char*>(b.results.data()), sizeof(int32_t) * b.count);
+            }
+        }
+        processed += b.count;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            b.ready = false;
+        }
+        cv.notify_all();
+    }
+    prefetcher.join();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Images:     " << processed << " in " << elapsed << " s (" << processed / elapsed << " images/s)"
+              << std::endl;
+    if (failed) {
+        std::cout << "Failed:     " << failed << std::endl;
+    }
+    if (labelled) {
+        std::cout << "Accuracy:   " << 100.0 * correct / labelled << "% (" << correct << "/" << labelled << ")"
+                  << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
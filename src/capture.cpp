@@ -0,0 +1,158 @@
+#include "capture.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+inline size_t paddedLength(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+} // namespace
+
+TrafficCapture::~TrafficCapture() {
+    close();
+}
+
+bool TrafficCapture::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFile = std::fopen(path.c_str(), "wb");
+    if (!mFile) {
+        std::cerr << "Could not open capture file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    // Records are small and frequent; a large stdio buffer keeps the write syscalls off the request path.
+    std::setvbuf(mFile, nullptr, _IOFBF, 1 << 20);
+
+    CaptureFileHeader header{};
+    memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+    header.version = kCaptureVersion;
+    header.startEpochNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    mStartNs = nowNs();
+    return std::fwrite(&header, sizeof(header), 1, mFile) == 1;
+}
+
+int64_t TrafficCapture::now() const {
+    return nowNs() - mStartNs;
+}
+
+bool TrafficCapture::append(int64_t arrivalNs, std::string_view target, std::string_view contentType,
+    std::string_view accept, std::string_view body, int status, std::string_view response) {
+    const size_t payload = target.size() + contentType.size() + accept.size() + body.size() + response.size();
+    const size_t length = paddedLength(payload);
+    if (length > UINT32_MAX) {
+        return false;
+    }
+
+    CaptureRecordHeader header{};
+    header.length = static_cast<uint32_t>(length);
+    header.status = static_cast<uint32_t>(status);
+    header.arrivalNs = arrivalNs;
+    header.targetLen = static_cast<uint32_t>(target.size());
+    header.contentTypeLen = static_cast<uint32_t>(contentType.size());
+    header.acceptLen = static_cast<uint32_t>(accept.size());
+    header.bodyLen = static_cast<uint32_t>(body.size());
+    header.responseLen = static_cast<uint32_t>(response.size());
+
+    static const char kPadding[8] = {};
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mFile) {
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, mFile) == 1;
+    ok = ok && std::fwrite(target.data(), 1, target.size(), mFile) == target.size();
+    ok = ok && std::fwrite(contentType.data(), 1, contentType.size(), mFile) == contentType.size();
+    ok = ok && std::fwrite(accept.data(), 1, accept.size(), mFile) == accept.size();
+    ok = ok && std::fwrite(body.data(), 1, body.size(), mFile) == body.size();
+    ok = ok && std::fwrite(response.data(), 1, response.size(), mFile) == response.size();
+    ok = ok && std::fwrite(kPadding, 1, length - payload, mFile) == length - payload;
+    return ok;
+}
+
+void TrafficCapture::close() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFile) {
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+CaptureReader::~CaptureReader() {
+    if (mData) {
+        munmap(mData, mSize);
+    }
+}
+
+bool CaptureReader::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open capture file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CaptureFileHeader)) {
+        std::cerr << "Capture file " << path << " is too small" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    mSize = static_cast<size_t>(st.st_size);
+    mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mData == MAP_FAILED) {
+        mData = nullptr;
+        std::cerr << "Could not map capture file " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    madvise(mData, mSize, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(mData);
+    const auto* fileHeader = reinterpret_cast<const CaptureFileHeader*>(base);
+    if (memcmp(fileHeader->magic, kCaptureMagic, sizeof(kCaptureMagic)) != 0
+        || fileHeader->version != kCaptureVersion) {
+        std::cerr << path << " is not a version " << kCaptureVersion << " capture file" << std::endl;
+        return false;
+    }
+    mStartEpochNs = fileHeader->startEpochNs;
+
+    size_t offset = sizeof(CaptureFileHeader);
+    while (offset + sizeof(CaptureRecordHeader) <= mSize) {
+        const auto* header = reinterpret_cast<const CaptureRecordHeader*>(base + offset);
+        const size_t payload = size_t(header->targetLen) + header->contentTypeLen + header->acceptLen
+            + header->bodyLen + header->responseLen;
+        const size_t end = offset + sizeof(CaptureRecordHeader) + header->length;
+        if (payload > header->length || end > mSize) {
+            std::cerr << "Dropping truncated record at offset " << offset << std::endl;
+            break;
+        }
+        const char* p = base + offset + sizeof(CaptureRecordHeader);
+        CaptureRecord record;
+        record.arrivalNs = header->arrivalNs;
+        record.status = static_cast<int>(header->status);
+        auto take = [&p](uint32_t length) {
+            std::string_view field(p, length);
+            p += length;
+            return field;
+        };
+        record.target = take(header->targetLen);
+        record.contentType = take(header->contentTypeLen);
+        record.accept = take(header->acceptLen);
+        record.body = take(header->bodyLen);
+        record.response = take(header->responseLen);
+        mRecords.push_back(record);
+        offset = end;
+    }
+    // Records are appended when the response is ready, so concurrent requests are stored in completion order
+    std::stable_sort(mRecords.begin(), mRecords.end(),
+        [](const CaptureRecord& a, const CaptureRecord& b) { return a.arrivalNs < b.arrivalNs; });
+    return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//!
+//! Binary traffic capture.
+//!
+//! A capture file is a CaptureFileHeader followed by length-prefixed records. Every record starts with a
+//! CaptureRecordHeader and is padded to 8 bytes so the whole file can be memory-mapped and walked in place.
+//! All integers are little-endian.
+//!
+//!   [CaptureFileHeader]
+//!   [CaptureRecordHeader][request target][content type][accept][request body][response body][padding] ...
+//!
+
+static const char kCaptureMagic[8] = {'T', 'R', 'T', 'C', 'A', 'P', '\0', '\0'};
+static const uint32_t kCaptureVersion = 2;
+
+struct CaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int64_t startEpochNs; //!< Wall clock time the capture was started, for reference only.
+};
+
+struct CaptureRecordHeader {
+    uint32_t length;         //!< Bytes following this header, including padding.
+    uint32_t status;         //!< HTTP status the server answered with.
+    int64_t arrivalNs;       //!< Arrival time relative to the start of the capture.
+    uint32_t targetLen;      //!< Length of the request target: path and query string.
+    uint32_t contentTypeLen; //!< Length of the Content-Type header value (carries the multipart boundary).
+    uint32_t acceptLen;      //!< Length of the Accept header value, which selects the response encoding.
+    uint32_t bodyLen;        //!< Length of the request body.
+    uint32_t responseLen;    //!< Length of the response body.
+    uint32_t reserved;
+};
+
+static_assert(sizeof(CaptureFileHeader) == 24, "capture file header layout changed");
+static_assert(sizeof(CaptureRecordHeader) == 40, "capture record header layout changed");
+
+//!
+//! \brief Appends requests to a capture file. Safe to call from multiple HTTP worker threads.
+//!
+class TrafficCapture {
+public:
+    TrafficCapture() = default;
+    ~TrafficCapture();
+
+    TrafficCapture(const TrafficCapture&) = delete;
+    TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+    //!
+    //! \brief Creates (truncates) the capture file and writes the file header.
+    //!
+    bool open(const std::string& path);
+
+    bool isOpen() const {
+        return mFile != nullptr;
+    }
+
+    //!
+    //! \brief Returns the current time relative to the start of the capture.
+    //!
+    int64_t now() const;
+
+    //!
+    //! \brief Appends one record. Returns false if the write failed.
+    //!
+    bool append(int64_t arrivalNs, std::string_view target, std::string_view contentType, std::string_view accept,
+        std::string_view body, int status, std::string_view response);
+
+    void close();
+
+private:
+    std::mutex mMutex;
+    std::FILE* mFile{nullptr};
+    int64_t mStartNs{0}; //!< steady_clock time of open().
+};
+
+//!
+//! \brief View of one captured request. Views point into the mapped file.
+//!
+struct CaptureRecord {
+    int64_t arrivalNs;
+    int status;
+    std::string_view target;
+    std::string_view contentType;
+    std::string_view accept; //!< Empty if the request had no Accept header.
+    std::string_view body;
+    std::string_view response;
+};
+
+//!
+//! \brief Memory-maps a capture file read-only and indexes its records.
+//!
+class CaptureReader {
+public:
+    CaptureReader() = default;
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    //!
+    //! \brief Maps the file and validates every record. A truncated trailing record (e.g. the server was killed
+    //!        mid-write) is dropped with a warning rather than failing the whole capture.
+    //!
+    bool open(const std::string& path);
+
+    //!
+    //! \brief The records in order of arrival. The file holds them in the order the responses completed.
+    //!
+    const std::vector<CaptureRecord>& records() const {
+        return mRecords;
+    }
+
+    int64_t startEpochNs() const {
+        return mStartEpochNs;
+    }
+
+private:
+    void* mData{nullptr};
+    size_t mSize{0};
+    int64_t mStartEpochNs{0};
+    std::vector<CaptureRecord> mRecords;
+};
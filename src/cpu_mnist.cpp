@@ -0,0 +1,360 @@
+#include "cpu_mnist.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include "common.h"
+#include "plan_cache.h"
+
+namespace {
+
+//!
+//! \brief Minimal protobuf wire-format reader, enough to pull TensorProto initializers out of an ONNX file.
+//!
+class ProtoReader {
+public:
+    ProtoReader(std::string_view data)
+        : mPos(reinterpret_cast<const uint8_t*>(data.data()))
+        , mEnd(mPos + data.size())
+    {
+    }
+
+    bool next(uint32_t& field, uint32_t& wireType) {
+        if (mPos >= mEnd) {
+            return false;
+        }
+        uint64_t key = varint();
+        field = static_cast<uint32_t>(key >> 3);
+        wireType = static_cast<uint32_t>(key & 7);
+        return mOk;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && mPos < mEnd; shift += 7) {
+            uint8_t byte = *mPos++;
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+        mOk = false;
+        return 0;
+    }
+
+    std::string_view bytes() {
+        uint64_t length = varint();
+        if (length > static_cast<uint64_t>(mEnd - mPos)) {
+            mOk = false;
+            mPos = mEnd;
+            return {};
+        }
+        std::string_view view(reinterpret_cast<const char*>(mPos), length);
+        mPos += length;
+        return view;
+    }
+
+    void skip(uint32_t wireType) {
+        switch (wireType) {
+        case 0: varint(); break;
+        case 1: mPos += 8; break;
+        case 2: bytes(); break;
+        case 5: mPos += 4; break;
+        default: mOk = false; mPos = mEnd; break;
+        }
+        if (mPos > mEnd) {
+            mOk = false;
+            mPos = mEnd;
+        }
+    }
+
+    bool ok() const {
+        return mOk;
+    }
+
+private:
+    const uint8_t* mPos;
+    const uint8_t* mEnd;
+    bool mOk{true};
+};
+
+//!
+//! \brief Reads every float initializer of an ONNX model (ModelProto.graph.initializer) by name.
+//!
+bool readInitializers(const std::string& onnx, std::unordered_map<std::string, std::vector<float>>& tensors) {
+    // ModelProto.graph = 7, GraphProto.initializer = 5,
+    // TensorProto: data_type = 2, float_data = 4, name = 8, raw_data = 9
+    const int32_t kFloat = 1;
+    ProtoReader model(onnx);
+    uint32_t field, wire;
+    while (model.next(field, wire)) {
+        if (field != 7 || wire != 2) {
+            model.skip(wire);
+            continue;
+        }
+        ProtoReader graph(model.bytes());
+        while (graph.next(field, wire)) {
+            if (field != 5 || wire != 2) {
+                graph.skip(wire);
+                continue;
+            }
+            ProtoReader tensor(graph.bytes());
+            std::string name;
+            int64_t dataType = 0;
+            std::vector<float> values;
+            while (tensor.next(field, wire)) {
+                if (field == 2 && wire == 0) {
+                    dataType = static_cast<int64_t>(tensor.varint());
+                } else if (field == 8 && wire == 2) {
+                    name = std::string(tensor.bytes());
+                } else if (field == 9 && wire == 2) {
+                    auto raw = tensor.bytes();
+                    values.resize(raw.size() / sizeof(float));
+                    memcpy(values.data(), raw.data(), values.size() * sizeof(float));
+                } else if (field == 4 && wire == 2) {
+                    auto packed = tensor.bytes();
+                    size_t offset = values.size();
+                    values.resize(offset + packed.size() / sizeof(float));
+                    memcpy(values.data() + offset, packed.data(), (values.size() - offset) * sizeof(float));
+                } else {
+                    tensor.skip(wire);
+                }
+            }
+            if (!tensor.ok()) {
+                return false;
+            }
+            if (dataType == kFloat) {
+                tensors[name] = std::move(values);
+            }
+        }
+        if (!graph.ok()) {
+            return false;
+        }
+    }
+    return model.ok();
+}
+
+//!
+//! \brief 5x5 convolution, stride 1, SAME padding, followed by bias and ReLU. in is [inC,h,w], out is [outC,h,w].
+//!
+void conv5x5Relu(const float* in, int inC, int h, int w, const float* weights, const float* bias, int outC,
+    float* out) {
+    const int kPad = 2;
+    const int ph = h + 2 * kPad;
+    const int pw = w + 2 * kPad;
+    std::vector<float> padded(static_cast<size_t>(inC) * ph * pw, 0.0F);
+    for (int c = 0; c < inC; c++) {
+        for (int y = 0; y < h; y++) {
+            std::copy(in + (c * h + y) * w, in + (c * h + y + 1) * w, padded.data() + (c * ph + y + kPad) * pw + kPad);
+        }
+    }
+
+    for (int oc = 0; oc < outC; oc++) {
+        float* o = out + oc * h * w;
+        std::fill(o, o + h * w, bias[oc]);
+        for (int ic = 0; ic < inC; ic++) {
+            const float* p = padded.data() + ic * ph * pw;
+            const float* k = weights + (oc * inC + ic) * 25;
+            for (int ky = 0; ky < 5; ky++) {
+                for (int kx = 0; kx < 5; kx++) {
+                    const float wv = k[ky * 5 + kx];
+                    for (int y = 0; y < h; y++) {
+                        const float* row = p + (y + ky) * pw + kx;
+                        float* orow = o + y * w;
+                        for (int x = 0; x < w; x++) {
+                            orow[x] += wv * row[x];
+                        }
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < h * w; i++) {
+            o[i] = std::max(o[i], 0.0F);
+        }
+    }
+}
+
+//!
+//! \brief Max pooling with a square window equal to its stride and no padding (floor rounding).
+//!
+void maxPool(const float* in, int c, int h, int w, int k, float* out) {
+    const int oh = h / k;
+    const int ow = w / k;
+    for (int ch = 0; ch < c; ch++) {
+        for (int y = 0; y < oh; y++) {
+            for (int x = 0; x < ow; x++) {
+                float m = in[(ch * h + y * k) * w + x * k];
+                for (int dy = 0; dy < k; dy++) {
+                    for (int dx = 0; dx < k; dx++) {
+                        m = std::max(m, in[(ch * h + y * k + dy) * w + x * k + dx]);
+                    }
+                }
+                out[(ch * oh + y) * ow + x] = m;
+            }
+        }
+    }
+}
+
+//! Sizes of the packed weights, in the order they are stored.
+const size_t kWeightSizes[] = {8 * 1 * 5 * 5, 8, 16 * 8 * 5 * 5, 16, 16 * 4 * 4 * CpuMnistApi::kClasses,
+    CpuMnistApi::kClasses};
+const size_t kWeightCount = 8 * 1 * 5 * 5 + 8 + 16 * 8 * 5 * 5 + 16 + 16 * 4 * 4 * CpuMnistApi::kClasses
+    + CpuMnistApi::kClasses;
+
+} // namespace
+
+CpuMnistApi::CpuMnistApi(int threads, std::string planCache)
+    : mThreads(std::max(1, threads))
+    , mPlanCachePath(std::move(planCache))
+{
+}
+
+CpuMnistApi::~CpuMnistApi() = default;
+
+bool CpuMnistApi::readWeights(const std::string& path, std::vector<float>& weights) {
+    std::ifstream file(path, std::ios::binary);
+    std::string onnx((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::unordered_map<std::string, std::vector<float>> tensors;
+    if (!readInitializers(onnx, tensors)) {
+        std::cout << "Could not parse " << path << std::endl;
+        return false;
+    }
+    const char* names[] = {"Parameter5", "Parameter6", "Parameter87", "Parameter88", "Parameter193", "Parameter194"};
+    weights.clear();
+    weights.reserve(kWeightCount);
+    for (size_t i = 0; i < std::size(names); i++) {
+        auto it = tensors.find(names[i]);
+        if (it == tensors.end() || it->second.size() != kWeightSizes[i]) {
+            std::cout << path << " does not look like the MNIST model: bad initializer " << names[i] << std::endl;
+            return false;
+        }
+        weights.insert(weights.end(), it->second.begin(), it->second.end());
+    }
+    return true;
+}
+
+void CpuMnistApi::setWeights(const float* weights) {
+    const float** dst[] = {&mConv1Weights, &mConv1Bias, &mConv2Weights, &mConv2Bias, &mFcWeights, &mFcBias};
+    for (size_t i = 0; i < std::size(dst); i++) {
+        *dst[i] = weights;
+        weights += kWeightSizes[i];
+    }
+}
+
+bool CpuMnistApi::load() {
+    const std::vector<std::string> dataDirs{"data/mnist/", "data/samples/mnist/", "models/"};
+    auto path = locateFile("mnist.onnx", dataDirs, false);
+    if (path.empty()) {
+        return false;
+    }
+    if (mPlanCachePath.empty()) {
+        mPlan.reset();
+        if (!readWeights(path, mWeights)) {
+            return false;
+        }
+        setWeights(mWeights.data());
+        return true;
+    }
+
+    mWeights = std::vector<float>();
+    mPlan = PlanCache::open(mPlanCachePath, planCacheKey("cpu", path), [&path](std::string& payload) {
+        std::vector<float> weights;
+        if (!readWeights(path, weights)) {
+            return false;
+        }
+        payload.assign(reinterpret_cast<const char*>(weights.data()), weights.size() * sizeof(float));
+        return true;
+    });
+    if (!mPlan || mPlan->size() != kWeightCount * sizeof(float)) {
+        std::cout << "Could not map the weights from " << mPlanCachePath << std::endl;
+        mPlan.reset();
+        return false;
+    }
+    setWeights(reinterpret_cast<const float*>(mPlan->data()));
+    return true;
+}
+
+void CpuMnistApi::forward(const uint8_t *image, float *logits) const {
+    float input[kInputH * kInputW];
+    float conv1[8 * 28 * 28];
+    float pool1[8 * 14 * 14];
+    float conv2[16 * 14 * 14];
+    float pool2[16 * 4 * 4];
+
+    // Same normalization as the TensorRT path (Inference::processInput).
+    for (int i = 0; i < kInputH * kInputW; i++) {
+        input[i] = 1.0F - image[i] / 255.0F;
+    }
+    conv5x5Relu(input, 1, 28, 28, mConv1Weights, mConv1Bias, 8, conv1);
+    maxPool(conv1, 8, 28, 28, 2, pool1);
+    conv5x5Relu(pool1, 8, 14, 14, mConv2Weights, mConv2Bias, 16, conv2);
+    maxPool(conv2, 16, 14, 14, 3, pool2);
+
+    for (int j = 0; j < kClasses; j++) {
+        logits[j] = mFcBias[j];
+    }
+    for (int i = 0; i < 16 * 4 * 4; i++) {
+        const float* row = mFcWeights + i * kClasses;
+        for (int j = 0; j < kClasses; j++) {
+            logits[j] += pool2[i] * row[j];
+        }
+    }
+}
+
+int CpuMnistApi::infer(const char *data) {
+    float logits[kClasses];
+    forward(reinterpret_cast<const uint8_t*>(data), logits);
+    return static_cast<int>(std::max_element(logits, logits + kClasses) - logits);
+}
+
+int CpuMnistApi::inferProbabilities(const char *data, float *probabilities) {
+    forward(reinterpret_cast<const uint8_t*>(data), probabilities);
+    const int idx = static_cast<int>(std::max_element(probabilities, probabilities + kClasses) - probabilities);
+    // Softmax, shifted by the largest logit so exp() cannot overflow
+    const float maxLogit = probabilities[idx];
+    float sum{0.0F};
+    for (int i = 0; i < kClasses; i++) {
+        probabilities[i] = std::exp(probabilities[i] - maxLogit);
+        sum += probabilities[i];
+    }
+    for (int i = 0; i < kClasses; i++) {
+        probabilities[i] /= sum;
+    }
+    return idx;
+}
+
+void CpuMnistApi::inferBatch(const char *data, int count, int *results) {
+    auto run = [this, data, results](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            results[i] = infer(data + static_cast<size_t>(i) * inputSize());
+        }
+    };
+    const int threads = std::min(mThreads, count / 8);
+    if (threads <= 1) {
+        run(0, count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    const int chunk = (count + threads - 1) / threads;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back(run, t * chunk, std::min(count, (t + 1) * chunk));
+    }
+    run(0, std::min(count, chunk));
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+ModelMemory CpuMnistApi::memoryUsage() const {
+    // Mapped weights are shared with other processes but still resident in this one
+    ModelMemory memory;
+    memory.hostBytes = mPlan ? mPlan->size() : mWeights.capacity() * sizeof(float);
+    return memory;
+}
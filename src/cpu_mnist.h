@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "model.h"
+
+class PlanCache;
+
+//!
+//! \brief Runs the MNIST network from mnist.onnx on the CPU, without CUDA or TensorRT.
+//!
+//! Only the initializers (weights) are read from the ONNX file; the topology is the fixed
+//! Conv-Relu-MaxPool x2 + MatMul network the model ships with. Weights are immutable after load(), so
+//! infer() and inferBatch() may be called from several threads at once.
+//!
+//! With a plan cache path the weights are packed once into that file (see PlanCache) and mapped read-only,
+//! so every process serving the model shares one copy of them.
+//!
+class CpuMnistApi: public Model {
+public:
+    explicit CpuMnistApi(int threads = 1, std::string planCache = "");
+    virtual ~CpuMnistApi();
+    virtual bool load();
+    virtual int infer(const char *data);
+    virtual void inferBatch(const char *data, int count, int *results);
+    virtual int inferProbabilities(const char *data, float *probabilities);
+    virtual ModelMemory memoryUsage() const;
+
+    //!
+    //! \brief Runs the network on one 28x28 image and writes the 10 class logits.
+    //!
+    void forward(const uint8_t *image, float *logits) const;
+
+    static const int kInputH = 28;
+    static const int kInputW = 28;
+    static const int kClasses = 10;
+
+private:
+    //!
+    //! \brief Reads the initializers from mnist.onnx into weights, packed in the order of the pointers below.
+    //!
+    static bool readWeights(const std::string& path, std::vector<float>& weights);
+    void setWeights(const float* weights);
+
+    int mThreads; //!< Threads inferBatch() splits a batch across.
+    std::string mPlanCachePath;
+    std::vector<float> mWeights;       //!< Packed weights when they are not mapped from the plan cache.
+    std::unique_ptr<PlanCache> mPlan;
+    const float* mConv1Weights{nullptr}; //!< [8,1,5,5]
+    const float* mConv1Bias{nullptr};    //!< [8]
+    const float* mConv2Weights{nullptr}; //!< [16,8,5,5]
+    const float* mConv2Bias{nullptr};    //!< [16]
+    const float* mFcWeights{nullptr};    //!< [256,10]
+    const float* mFcBias{nullptr};       //!< [10]
+};
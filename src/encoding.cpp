@@ -0,0 +1,377 @@
+#include "encoding.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size()
+        && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) { return tolower(x) == tolower(y); });
+}
+
+void appendInt(std::string& out, int64_t value) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr);
+}
+
+void appendFloat(std::string& out, float value) {
+    // JSON has no NaN or infinity; MessagePack and the binary layout carry them as they are. Tested on the
+    // exponent bits because -Ofast lets the compiler assume std::isfinite() is always true.
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7f800000U) == 0x7f800000U) {
+        out += "null";
+        return;
+    }
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr);
+}
+
+// MessagePack primitives; multi-byte values are big-endian.
+void packBigEndian(std::string& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+void packInt(std::string& out, int64_t value) {
+    if (value >= 0 && value < 128) {
+        out.push_back(static_cast<char>(value));
+    } else if (value < 0 && value >= -32) {
+        out.push_back(static_cast<char>(0xe0 | (value + 32)));
+    } else if (value >= 0 && value < 256) {
+        out.push_back(static_cast<char>(0xcc));
+        packBigEndian(out, static_cast<uint64_t>(value), 1);
+    } else if (value >= INT16_MIN && value <= INT16_MAX) {
+        out.push_back(static_cast<char>(0xd1));
+        packBigEndian(out, static_cast<uint16_t>(value), 2);
+    } else {
+        out.push_back(static_cast<char>(0xd2));
+        packBigEndian(out, static_cast<uint32_t>(value), 4);
+    }
+}
+
+void packFloat(std::string& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out.push_back(static_cast<char>(0xca));
+    packBigEndian(out, bits, 4);
+}
+
+void packString(std::string& out, std::string_view s) {
+    // All keys are short
+    out.push_back(static_cast<char>(0xa0 | s.size()));
+    out.append(s);
+}
+
+void packArray(std::string& out, size_t n) {
+    if (n < 16) {
+        out.push_back(static_cast<char>(0x90 | n));
+    } else if (n <= UINT16_MAX) {
+        out.push_back(static_cast<char>(0xdc));
+        packBigEndian(out, n, 2);
+    } else {
+        out.push_back(static_cast<char>(0xdd));
+        packBigEndian(out, n, 4);
+    }
+}
+
+void packMap(std::string& out, size_t n) {
+    out.push_back(static_cast<char>(0x80 | n));
+}
+
+int httpStatus(uint8_t status) {
+    return status == 0 ? 200 : 400;
+}
+
+} // namespace
+
+Encoding negotiateEncoding(std::string_view accept) {
+    Encoding best = Encoding::kJSON;
+    float bestQ = -1.0F;
+    while (!accept.empty()) {
+        size_t comma = accept.find(',');
+        std::string_view range = accept.substr(0, comma);
+        accept = comma == std::string_view::npos ? std::string_view() : accept.substr(comma + 1);
+
+        size_t semicolon = range.find(';');
+        std::string_view type = trim(range.substr(0, semicolon));
+        float q = 1.0F;
+        bool half = false;
+        while (semicolon != std::string_view::npos) {
+            range = range.substr(semicolon + 1);
+            semicolon = range.find(';');
+            std::string_view param = trim(range.substr(0, semicolon));
+            size_t eq = param.find('=');
+            if (eq == std::string_view::npos) {
+                continue;
+            }
+            std::string_view key = trim(param.substr(0, eq));
+            std::string_view value = trim(param.substr(eq + 1));
+            if (equalsIgnoreCase(key, "q")) {
+                q = strtof(std::string(value).c_str(), nullptr);
+            } else if (equalsIgnoreCase(key, "dtype")) {
+                half = equalsIgnoreCase(value, "float16");
+            }
+        }
+
+        Encoding encoding;
+        if (equalsIgnoreCase(type, "application/json") || type == "*/*" || equalsIgnoreCase(type, "application/*")) {
+            encoding = Encoding::kJSON;
+        } else if (equalsIgnoreCase(type, "application/msgpack") || equalsIgnoreCase(type, "application/x-msgpack")) {
+            encoding = Encoding::kMSGPACK;
+        } else if (equalsIgnoreCase(type, "application/x-mnist-batch")) {
+            encoding = half ? Encoding::kBINARY_F16 : Encoding::kBINARY_F32;
+        } else {
+            continue;
+        }
+        if (q > bestQ) {
+            best = encoding;
+            bestQ = q;
+        }
+    }
+    return bestQ > 0.0F ? best : Encoding::kJSON;
+}
+
+const char* contentType(Encoding encoding) {
+    switch (encoding) {
+    case Encoding::kJSON: return "application/json";
+    case Encoding::kMSGPACK: return "application/msgpack";
+    case Encoding::kBINARY_F32: return "application/x-mnist-batch; dtype=float32";
+    case Encoding::kBINARY_F16: return "application/x-mnist-batch; dtype=float16";
+    }
+    return "application/json";
+}
+
+void encodeResult(const BatchResult& result, Encoding encoding, std::string& out) {
+    switch (encoding) {
+    case Encoding::kJSON: encodeJSON(result, out); break;
+    case Encoding::kMSGPACK: encodeMsgPack(result, out); break;
+    case Encoding::kBINARY_F32: encodeBinary(result, false, out); break;
+    case Encoding::kBINARY_F16: encodeBinary(result, true, out); break;
+    }
+}
+
+void encodeJSON(const BatchResult& result, std::string& out) {
+    const size_t n = result.size();
+    const int classes = result.classes;
+    out.reserve(out.size() + 32 + n * (16 + (result.withProbabilities ? classes * 14 : 0)));
+
+    auto appendProbabilities = [&](size_t i) {
+        out.push_back('[');
+        if (result.status[i] == 0) {
+            const float* p = result.probabilities.data() + i * classes;
+            for (int c = 0; c < classes; c++) {
+                if (c) {
+                    out.push_back(',');
+                }
+                appendFloat(out, p[c]);
+            }
+        }
+        out.push_back(']');
+    };
+
+    if (!result.batch) {
+        out += "{\"Result\":";
+        appendInt(out, n ? result.results[0] : -1);
+        if (result.withProbabilities && n) {
+            out += ",\"Probabilities\":";
+            appendProbabilities(0);
+        }
+        out.push_back('}');
+        return;
+    }
+
+    out += "{\"Results\":[";
+    for (size_t i = 0; i < n; i++) {
+        if (i) {
+            out.push_back(',');
+        }
+        appendInt(out, result.results[i]);
+    }
+    out += "],\"Status\":[";
+    for (size_t i = 0; i < n; i++) {
+        if (i) {
+            out.push_back(',');
+        }
+        appendInt(out, httpStatus(result.status[i]));
+    }
+    out.push_back(']');
+    if (result.withProbabilities) {
+        out += ",\"Probabilities\":[";
+        for (size_t i = 0; i < n; i++) {
+            if (i) {
+                out.push_back(',');
+            }
+            appendProbabilities(i);
+        }
+        out.push_back(']');
+    }
+    out.push_back('}');
+}
+
+void encodeMsgPack(const BatchResult& result, std::string& out) {
+    const size_t n = result.size();
+    const int classes = result.classes;
+    out.reserve(out.size() + 32 + n * (8 + (result.withProbabilities ? classes * 5 + 3 : 0)));
+
+    auto packProbabilities = [&](size_t i) {
+        if (result.status[i] != 0) {
+            packArray(out, 0);
+            return;
+        }
+        packArray(out, classes);
+        const float* p = result.probabilities.data() + i * classes;
+        for (int c = 0; c < classes; c++) {
+            packFloat(out, p[c]);
+        }
+    };
+
+    if (!result.batch) {
+        const bool probabilities = result.withProbabilities && n;
+        packMap(out, probabilities ? 2 : 1);
+        packString(out, "Result");
+        packInt(out, n ? result.results[0] : -1);
+        if (probabilities) {
+            packString(out, "Probabilities");
+            packProbabilities(0);
+        }
+        return;
+    }
+
+    packMap(out, result.withProbabilities ? 3 : 2);
+    packString(out, "Results");
+    packArray(out, n);
+    for (size_t i = 0; i < n; i++) {
+        packInt(out, result.results[i]);
+    }
+    packString(out, "Status");
+    packArray(out, n);
+    for (size_t i = 0; i < n; i++) {
+        packInt(out, httpStatus(result.status[i]));
+    }
+    if (result.withProbabilities) {
+        packString(out, "Probabilities");
+        packArray(out, n);
+        for (size_t i = 0; i < n; i++) {
+            packProbabilities(i);
+        }
+    }
+}
+
+void encodeBinary(const BatchResult& result, bool half, std::string& out) {
+    const uint32_t n = static_cast<uint32_t>(result.size());
+    const uint16_t classes = static_cast<uint16_t>(result.classes);
+    const uint8_t dtype = result.withProbabilities ? (half ? 2 : 1) : 0;
+    const size_t header = 12;
+    const size_t columns = (header + n * sizeof(int32_t) + n + 3) & ~size_t(3);
+    const size_t elementSize = dtype == 0 ? 0 : dtype == 1 ? sizeof(float) : sizeof(uint16_t);
+    const size_t total = columns + size_t(n) * classes * elementSize;
+
+    const size_t start = out.size();
+    out.resize(start + total);
+    char* p = &out[start];
+    memcpy(p, "MNB1", 4);
+    memcpy(p + 4, &n, sizeof(n));
+    memcpy(p + 8, &classes, sizeof(classes));
+    p[10] = static_cast<char>(dtype);
+    p[11] = 0;
+    memcpy(p + header, result.results.data(), n * sizeof(int32_t));
+    memcpy(p + header + n * sizeof(int32_t), result.status.data(), n);
+    memset(p + header + n * sizeof(int32_t) + n, 0, columns - (header + n * sizeof(int32_t) + n));
+
+    char* probs = p + columns;
+    const size_t count = size_t(n) * classes;
+    if (dtype == 1) {
+        memcpy(probs, result.probabilities.data(), count * sizeof(float));
+    } else if (dtype == 2) {
+        for (size_t i = 0; i < count; i++) {
+            uint16_t h = floatToHalf(result.probabilities[i]);
+            memcpy(probs + i * sizeof(h), &h, sizeof(h));
+        }
+    }
+}
+
+void encodeTensor(const std::vector<int>& shape, const std::vector<float>& data, Encoding encoding, std::string& out) {
+    if (encoding == Encoding::kMSGPACK) {
+        packMap(out, 2);
+        packString(out, "Output");
+        packArray(out, data.size());
+        for (float value : data) {
+            packFloat(out, value);
+        }
+        packString(out, "Shape");
+        packArray(out, shape.size());
+        for (int dim : shape) {
+            packInt(out, dim);
+        }
+        return;
+    }
+
+    out.reserve(out.size() + 32 + data.size() * 14);
+    out += "{\"Output\":[";
+    for (size_t i = 0; i < data.size(); i++) {
+        if (i) {
+            out.push_back(',');
+        }
+        appendFloat(out, data[i]);
+    }
+    out += "],\"Shape\":[";
+    for (size_t i = 0; i < shape.size(); i++) {
+        if (i) {
+            out.push_back(',');
+        }
+        appendInt(out, shape[i]);
+    }
+    out += "]}";
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) { // Inf / NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    int32_t e = static_cast<int32_t>(exponent) - 127 + 15;
+    if (e >= 0x1f) { // Overflow
+        return sign | 0x7c00;
+    }
+    if (e <= 0) { // Subnormal or zero
+        if (e < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - e;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1U << shift) - 1);
+        const uint32_t halfway = 1U << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+    uint32_t half = (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++; // may carry into the exponent, which correctly rounds up to the next power of two / infinity
+    }
+    return sign | static_cast<uint16_t>(half);
+}
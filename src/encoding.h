@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//!
+//! Response encodings, chosen from the request's Accept header.
+//!
+//! JSON and MessagePack share one schema. A single upload is answered with
+//!   {"Result": 5}                                    or, with probabilities,
+//!   {"Result": 5, "Probabilities": [p0, ..., p9]}
+//! and a batch with
+//!   {"Results": [5, -1, ...], "Status": [200, 400, ...], "Probabilities": [[...], [], ...]}
+//!
+//! The binary layout (little-endian) is
+//!   char     magic[4] = "MNB1"
+//!   uint32   count
+//!   uint16   classes
+//!   uint8    dtype     0: no probabilities, 1: float32, 2: float16
+//!   uint8    reserved
+//!   int32    results[count]
+//!   uint8    status[count]       0: ok, 1: bad input
+//!   padding to a multiple of 4 bytes
+//!   dtype    probabilities[count * classes]
+//!
+
+enum class Encoding {
+    kJSON,
+    kMSGPACK,
+    kBINARY_F32,
+    kBINARY_F16,
+};
+
+//!
+//! \brief Picks the encoding with the highest q-value in an Accept header. Media types:
+//!        application/json, application/msgpack (or application/x-msgpack), and
+//!        application/x-mnist-batch with an optional dtype=float16 parameter. Anything else means JSON.
+//!
+Encoding negotiateEncoding(std::string_view accept);
+
+const char* contentType(Encoding encoding);
+
+//!
+//! \brief Results of one request, stored column-wise so the encoders can stream them out.
+//!
+struct BatchResult {
+    int classes{0};
+    bool batch{false};                //!< Single-image requests use the {"Result": ...} shape.
+    bool withProbabilities{false};
+    std::vector<int32_t> results;     //!< Predicted class, -1 for items that failed.
+    std::vector<uint8_t> status;      //!< 0 ok, 1 bad input.
+    std::vector<float> probabilities; //!< results.size() * classes when withProbabilities.
+
+    size_t size() const {
+        return results.size();
+    }
+};
+
+//!
+//! \brief Appends the encoded result to out. The encoders write directly into out, without building a DOM.
+//!
+void encodeResult(const BatchResult& result, Encoding encoding, std::string& out);
+
+void encodeJSON(const BatchResult& result, std::string& out);
+void encodeMsgPack(const BatchResult& result, std::string& out);
+void encodeBinary(const BatchResult& result, bool half, std::string& out);
+
+//!
+//! \brief Appends a pipeline output as {"Output": [...], "Shape": [...]} in JSON or MessagePack. The binary
+//!        layout only describes classification results, so it is encoded as JSON.
+//!
+void encodeTensor(const std::vector<int>& shape, const std::vector<float>& data, Encoding encoding, std::string& out);
+
+//!
+//! \brief IEEE 754 binary32 to binary16, round to nearest even.
+//!
+uint16_t floatToHalf(float value);
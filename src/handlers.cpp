@@ -0,0 +1,150 @@
+#include "handlers.h"
+
+#include "multipart.h"
+#include "pgm.h"
+
+namespace {
+
+//!
+//! \brief Finds the first part named "file" of a multipart/form-data request, without copying it.
+//!
+bool findFilePart(const crow::request& req, MultipartPart& part) {
+    std::string_view boundary;
+    return multipartBoundary(req.get_header_value("Content-Type"), boundary)
+        && findMultipartPart(req.body, boundary, "file", part);
+}
+
+} // namespace
+
+crow::response encodeResponse(const crow::request& req, const BatchResult& result) {
+    Encoding encoding = negotiateEncoding(req.get_header_value("Accept"));
+    crow::response res(200);
+    encodeResult(result, encoding, res.body);
+    res.set_header("Content-Type", contentType(encoding));
+    return res;
+}
+
+crow::response handleUpload(InferenceService& service, const crow::request& req) {
+    // Only the "file" part matters: the body is scanned up to its end, and neither it nor any other part is copied
+    MultipartPart part;
+    if (!findFilePart(req, part)) {
+        return crow::response(200);
+    }
+    // Extract the file name
+    std::string_view filename;
+    if (!part.param("Content-Disposition", "filename", filename)) {
+        CROW_LOG_ERROR << "Part with name \"filename\" should have a file";
+        return crow::response(400);
+    }
+
+    // Create a new file with the extracted file name and write file contents to it
+    /* Test: Save to local file
+    const std::string outfile_name(filename);
+    std::ofstream out_file(outfile_name);
+    if (!out_file) {
+        CROW_LOG_ERROR << " Write to file failed\n";
+        return crow::response(500);
+    }
+    out_file << part.body;
+    out_file.close();
+    CROW_LOG_INFO << " Contents written to " << outfile_name << '\n';
+    */
+    BatchResult batchResult;
+    batchResult.classes = service.classCount();
+    batchResult.withProbabilities = req.url_params.get("probabilities") != nullptr;
+    batchResult.probabilities.resize(batchResult.withProbabilities ? batchResult.classes : 0);
+    auto result = service.classify(
+        part.body, batchResult.withProbabilities ? batchResult.probabilities.data() : nullptr);
+    if (result < 0) {
+        CROW_LOG_ERROR << "Part \"file\" is not a " << InferenceService::kInputH << "x"
+                       << InferenceService::kInputW << " binary PGM";
+        return crow::response(400);
+    }
+    CROW_LOG_DEBUG << " Inference reuslt: " << result << '\n';
+    batchResult.results.push_back(result);
+    batchResult.status.push_back(0);
+    return encodeResponse(req, batchResult);
+}
+
+crow::response handleBatch(InferenceService& service, const crow::request& req) {
+    // Parts are read in upload order, which is the order of the results
+    std::vector<std::string_view> images;
+    std::string_view boundary;
+    if (multipartBoundary(req.get_header_value("Content-Type"), boundary)) {
+        MultipartReader reader(req.body, boundary);
+        MultipartPart part;
+        while (reader.next(part)) {
+            if (part.name() == "file") {
+                images.push_back(part.body);
+            }
+        }
+    }
+    if (images.empty()) {
+        CROW_LOG_ERROR << "Batch request without \"file\" parts";
+        return crow::response(400);
+    }
+
+    BatchResult batchResult;
+    batchResult.batch = true;
+    batchResult.withProbabilities = req.url_params.get("probabilities") != nullptr;
+    service.classifyBatch(images, batchResult);
+    return encodeResponse(req, batchResult);
+}
+
+crow::response handlePipeline(const PipelineRegistry& pipelines, const std::string& name, const crow::request& req) {
+    const Pipeline* pipeline = pipelines.find(name);
+    if (!pipeline) {
+        return crow::response(404);
+    }
+    MultipartPart part;
+    if (!findFilePart(req, part)) {
+        CROW_LOG_ERROR << "Pipeline request without a \"file\" part";
+        return crow::response(400);
+    }
+    std::vector<uint8_t> image(static_cast<size_t>(pipeline->inputH()) * pipeline->inputW());
+    if (!decodePGM(part.body, image.data(), pipeline->inputH(), pipeline->inputW())) {
+        CROW_LOG_ERROR << "Part \"file\" is not a " << pipeline->inputH() << "x" << pipeline->inputW()
+                       << " binary PGM";
+        return crow::response(400);
+    }
+    Tensor output = pipelines.run(*pipeline, image.data());
+
+    Encoding encoding = negotiateEncoding(req.get_header_value("Accept"));
+    if (encoding != Encoding::kMSGPACK) {
+        encoding = Encoding::kJSON;
+    }
+    crow::response res(200);
+    encodeTensor(output.shape, output.data, encoding, res.body);
+    res.set_header("Content-Type", contentType(encoding));
+    return res;
+}
+
+crow::response handleModelUpload(ModelRepository& repository, const std::string& name, const crow::request& req) {
+    MultipartPart part;
+    if (!findFilePart(req, part)) {
+        CROW_LOG_ERROR << "Request without a \"file\" part";
+        return crow::response(400);
+    }
+    uint8_t input[InferenceService::kInputH * InferenceService::kInputW];
+    if (!decodePGM(part.body, input, InferenceService::kInputH, InferenceService::kInputW)) {
+        CROW_LOG_ERROR << "Part \"file\" is not a " << InferenceService::kInputH << "x"
+                       << InferenceService::kInputW << " binary PGM";
+        return crow::response(400);
+    }
+    auto model = repository.acquire(name);
+    if (!model) {
+        CROW_LOG_ERROR << "Model " << name << " is unknown or failed to load";
+        return crow::response(404);
+    }
+
+    BatchResult batchResult;
+    batchResult.classes = model->classCount();
+    batchResult.withProbabilities = req.url_params.get("probabilities") != nullptr;
+    batchResult.probabilities.resize(batchResult.withProbabilities ? batchResult.classes : 0);
+    const char* data = reinterpret_cast<const char*>(input);
+    batchResult.results.push_back(batchResult.withProbabilities
+            ? model->inferProbabilities(data, batchResult.probabilities.data())
+            : model->infer(data));
+    batchResult.status.push_back(0);
+    return encodeResponse(req, batchResult);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include "crow.h"
+#include "encoding.h"
+#include "model_repository.h"
+#include "pipeline.h"
+#include "service.h"
+
+//!
+//! Request handlers of tensorrt_cpp_server, kept apart from its main() so that benchmarks can call them.
+//!
+
+//!
+//! \brief Encodes result in the format the client asked for in its Accept header.
+//!
+crow::response encodeResponse(const crow::request& req, const BatchResult& result);
+
+//!
+//! \brief Classifies the part named "file", a binary PGM of the model's input size.
+//!
+crow::response handleUpload(InferenceService& service, const crow::request& req);
+
+//!
+//! \brief Classifies every part named "file" as one batch. Items that cannot be decoded are reported per item.
+//!
+crow::response handleBatch(InferenceService& service, const crow::request& req);
+
+//!
+//! \brief Runs a pipeline on the "file" part, a binary PGM of the pipeline's input size.
+//!
+crow::response handlePipeline(const PipelineRegistry& pipelines, const std::string& name, const crow::request& req);
+
+//!
+//! \brief Classifies the "file" part with a named model from the repository, loading it first if needed.
+//!
+crow::response handleModelUpload(ModelRepository& repository, const std::string& name, const crow::request& req);
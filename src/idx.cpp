@@ -0,0 +1,72 @@
+#include "idx.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+IdxFile::~IdxFile() {
+    if (mData) {
+        munmap(mData, mSize);
+    }
+}
+
+size_t IdxFile::itemSize() const {
+    size_t size = 1;
+    for (size_t i = 1; i < mDims.size(); i++) {
+        size *= mDims[i];
+    }
+    return size;
+}
+
+bool IdxFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        std::cerr << path << " is not an IDX file" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    mSize = static_cast<size_t>(st.st_size);
+    mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mData == MAP_FAILED) {
+        mData = nullptr;
+        std::cerr << "Could not map " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    madvise(mData, mSize, MADV_SEQUENTIAL);
+
+    // Magic: two zero bytes, the element type, and the number of dimensions. Dimensions are big-endian uint32.
+    const uint8_t* bytes = static_cast<const uint8_t*>(mData);
+    const uint8_t kUnsignedByte = 0x08;
+    if (bytes[0] != 0 || bytes[1] != 0 || bytes[2] != kUnsignedByte || bytes[3] == 0) {
+        std::cerr << path << " is not an unsigned byte IDX file" << std::endl;
+        return false;
+    }
+    const size_t nbDims = bytes[3];
+    const size_t headerSize = 4 + 4 * nbDims;
+    if (mSize < headerSize) {
+        std::cerr << path << " has a truncated header" << std::endl;
+        return false;
+    }
+    mDims.clear();
+    for (size_t i = 0; i < nbDims; i++) {
+        const uint8_t* d = bytes + 4 + 4 * i;
+        mDims.push_back(uint32_t(d[0]) << 24 | uint32_t(d[1]) << 16 | uint32_t(d[2]) << 8 | uint32_t(d[3]));
+    }
+    mPayload = bytes + headerSize;
+    if (mSize - headerSize < count() * itemSize()) {
+        std::cerr << path << " is shorter than its header says" << std::endl;
+        mDims.clear();
+        return false;
+    }
+    return true;
+}
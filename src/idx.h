@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//!
+//! \brief Read-only memory mapping of an IDX file (the MNIST "ubyte" format).
+//!
+//! Only unsigned byte payloads (type 0x08) are supported, which covers both the image and the label files.
+//!
+class IdxFile {
+public:
+    IdxFile() = default;
+    ~IdxFile();
+
+    IdxFile(const IdxFile&) = delete;
+    IdxFile& operator=(const IdxFile&) = delete;
+
+    bool open(const std::string& path);
+
+    //!
+    //! \brief Dimensions from the header, outermost first (e.g. {10000, 28, 28} for t10k-images).
+    //!
+    const std::vector<uint32_t>& dims() const {
+        return mDims;
+    }
+
+    //!
+    //! \brief Number of items along the first dimension.
+    //!
+    size_t count() const {
+        return mDims.empty() ? 0 : mDims[0];
+    }
+
+    //!
+    //! \brief Bytes per item, i.e. the product of all but the first dimension.
+    //!
+    size_t itemSize() const;
+
+    const uint8_t* item(size_t i) const {
+        return mPayload + i * itemSize();
+    }
+
+private:
+    void* mData{nullptr};
+    size_t mSize{0};
+    const uint8_t* mPayload{nullptr};
+    std::vector<uint32_t> mDims;
+};
@@ -0,0 +1,61 @@
+#include "metrics.h"
+
+#include <cstdlib>
+#include <sstream>
+
+std::atomic<int64_t>& Metrics::counter(const std::string& name, const std::string& help) {
+    return series(name, "counter", help);
+}
+
+std::atomic<int64_t>& Metrics::gauge(const std::string& name, const std::string& help) {
+    return series(name, "gauge", help);
+}
+
+std::atomic<int64_t>& Metrics::series(const std::string& name, const char* type, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Family& family = mFamilies[name.substr(0, name.find('{'))];
+    if (family.type.empty()) {
+        family.type = type;
+        family.help = help;
+    }
+    auto& value = family.series[name];
+    if (!value) {
+        value = std::make_unique<std::atomic<int64_t>>(0);
+    }
+    return *value;
+}
+
+void Metrics::render(std::string& out) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& family : mFamilies) {
+        out += "# HELP " + family.first + " " + family.second.help + "\n";
+        out += "# TYPE " + family.first + " " + family.second.type + "\n";
+        for (const auto& series : family.second.series) {
+            out += series.first + " " + std::to_string(series.second->load()) + "\n";
+        }
+    }
+}
+
+void Metrics::merge(const std::string& text, bool countersOnly) {
+    std::istringstream in(text);
+    std::string line, help, type;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 7, "# HELP ") == 0) {
+            const size_t space = line.find(' ', 7);
+            help = space == std::string::npos ? "" : line.substr(space + 1);
+            continue;
+        }
+        if (line.compare(0, 7, "# TYPE ") == 0) {
+            const size_t space = line.find(' ', 7);
+            type = space == std::string::npos ? "" : line.substr(space + 1);
+            continue;
+        }
+        const size_t space = line.rfind(' ');
+        if (line.empty() || line[0] == '#' || space == std::string::npos || type.empty()
+            || (countersOnly && type != "counter")) {
+            continue;
+        }
+        series(line.substr(0, space), type == "counter" ? "counter" : "gauge", help)
+            += std::strtoll(line.c_str() + space + 1, nullptr, 10);
+    }
+}
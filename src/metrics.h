@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+//!
+//! \brief Named integer counters and gauges, rendered in the Prometheus text format for /metrics.
+//!
+//! A series name may carry labels, e.g. tensorrt_requests_total{route="upload"}; series that share the part
+//! before '{' form one metric family with one HELP and TYPE line. Returned references stay valid for the
+//! lifetime of the registry, so hot paths look a series up once and then only touch the atomic.
+//!
+class Metrics {
+public:
+    std::atomic<int64_t>& counter(const std::string& name, const std::string& help);
+    std::atomic<int64_t>& gauge(const std::string& name, const std::string& help);
+
+    //!
+    //! \brief Appends every series to out, one "name value" line each, grouped by family.
+    //!
+    void render(std::string& out) const;
+
+    //!
+    //! \brief Adds every series of text, as produced by render(), to the series of the same name here. Used to
+    //!        sum the metrics of several worker processes; with countersOnly, gauges are skipped.
+    //!
+    void merge(const std::string& text, bool countersOnly = false);
+
+private:
+    struct Family {
+        std::string type;
+        std::string help;
+        std::map<std::string, std::unique_ptr<std::atomic<int64_t>>> series;
+    };
+
+    std::atomic<int64_t>& series(const std::string& name, const char* type, const std::string& help);
+
+    mutable std::mutex mMutex;
+    std::map<std::string, Family> mFamilies;
+};
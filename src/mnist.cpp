@@ -5,11 +5,15 @@
 #include <NvOnnxParser.h>
 #include <memory>
 #include <numeric>
+#include <algorithm>
 #include "buffers.h"
 #include <cmath>
 #include <iomanip>
 #include <string.h>
 #include "mnist.h"
+#include "mnist_io.h"
+#include "common.h"
+#include "plan_cache.h"
 
 using namespace nvinfer1;
 using namespace nvonnxparser;
@@ -19,7 +23,9 @@ class Logger : public nvinfer1::ILogger {
 public:
     void log(Severity severity, const char *msg) noexcept override {
         // suppress info-level messages
-        std::cout << msg << std::endl;
+        if (severity <= Severity::kWARNING) {
+            std::cout << msg << std::endl;
+        }
     }
 } gLogger;
 
@@ -33,6 +39,8 @@ struct ModelParams {
     std::vector<std::string> inputTensorNames;
     std::vector<std::string> outputTensorNames;
     std::string onnxFileName; //!< Filename of ONNX file of a network
+    std::string planCache;    //!< Serialized engine shared between processes; built from the ONNX file if stale
+    bool print{false};        //!< Print every input as ASCII art and its class probabilities, for debugging.
 };
 
 
@@ -51,55 +59,6 @@ ModelParams initializeModelParams() {
     return params;
 }
 
-//! Locate path to file, given its filename or filepath suffix and possible dirs it might lie in.
-//! Function will also walk back MAX_DEPTH dirs from CWD to check for such a file path.
-inline std::string locateFile(
-    const std::string& filepathSuffix, const std::vector<std::string>& directories, bool reportError = true)
-{
-    const int MAX_DEPTH{10};
-    bool found{false};
-    std::string filepath;
-
-    for (auto& dir : directories){
-        if (!dir.empty() && dir.back() != '/') {
-
-            filepath = dir + "/" + filepathSuffix;
-        } else {
-            filepath = dir + filepathSuffix;
-        }
-
-        for (int i = 0; i < MAX_DEPTH && !found; i++) {
-            const std::ifstream checkFile(filepath);
-            found = checkFile.is_open();
-            if (found){
-                break;
-            }
-
-            filepath = "../" + filepath; // Try again in parent dir
-        }
-
-        if (found){
-            break;
-        }
-
-        filepath.clear();
-    }
-
-    // Could not find the file
-    if (filepath.empty()){
-        const std::string dirList = std::accumulate(directories.begin() + 1, directories.end(), directories.front(),
-            [](const std::string& a, const std::string& b) { return a + "\n\t" + b; });
-        std::cout << "Could not find " << filepathSuffix << " in data directories:\n\t" << dirList << std::endl;
-
-        if (reportError){
-            std::cout << "&&&& FAILED" << std::endl;
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    return filepath;
-}
-
 struct InferDeleter {
     template <typename T>
     void operator()(T* obj) const{
@@ -108,34 +67,37 @@ struct InferDeleter {
 };
 
 
-/// Temporary half-precision expression.
-/// This class represents a half-precision expression which just stores a single-precision value internally.
-struct expr
-{
-    /// Conversion constructor.
-    /// \param f single-precision value to convert
-    explicit constexpr expr(float f) noexcept : value_(f) {}
-
-    /// Conversion to single-precision.
-    /// \return single precision value representing expression value
-    constexpr operator float() const noexcept
-    {
-        return value_;
-    }
-
-private:
-    /// Internal expression value stored in single-precision.
-    float value_;
-};
-
-static expr exp(float arg){
-    return expr(std::exp(arg));
-}
-
 class Inference {
 public:
     bool Build(ModelParams& params) {
         mParams = params;
+        mRuntime = std::shared_ptr<IRuntime>(createInferRuntime(gLogger));
+        if (mRuntime == nullptr) {
+            return false;
+        }
+
+        if (mParams.planCache.empty()) {
+            std::string plan;
+            if (!BuildPlan(plan)) {
+                return false;
+            }
+            return Deserialize(plan.data(), plan.size());
+        }
+
+        // Every worker process maps the same plan, so the engine is built only by the first one
+        const auto onnx = locateFile(mParams.onnxFileName, mParams.dataDirs);
+        auto cache = PlanCache::open(mParams.planCache, planCacheKey("tensorrt", onnx),
+            [this](std::string& plan) { return BuildPlan(plan); });
+        if (!cache) {
+            return false;
+        }
+        return Deserialize(cache->data(), cache->size());
+    }
+
+    //!
+    //! \brief Parses the ONNX file and builds a serialized engine.
+    //!
+    bool BuildPlan(std::string& serialized) {
         auto builder = std::unique_ptr<IBuilder>(createInferBuilder(gLogger));
         if (!builder){
             return false;
@@ -190,24 +152,24 @@ public:
         if (!plan){
             return false;
         }
+        serialized.assign(static_cast<const char*>(plan->data()), plan->size());
+        return true;
+    }
 
-        mRuntime = std::shared_ptr<IRuntime>(createInferRuntime(gLogger));   
-        if (mRuntime == nullptr) {
-            return false;
-        } 
-
-        mEngine = std::shared_ptr<ICudaEngine>(mRuntime->deserializeCudaEngine(plan->data(), plan->size()), InferDeleter());
+    bool Deserialize(const void* plan, size_t size) {
+        mPlanBytes = size;
+        mEngine = std::shared_ptr<ICudaEngine>(mRuntime->deserializeCudaEngine(plan, size), InferDeleter());
         if (!mEngine) {
             return false;
         }
-        mInputDims = network->getInput(0)->getDimensions();
-        mOutputDims = network->getOutput(0)->getDimensions();
+        mInputDims = mEngine->getTensorShape(mParams.inputTensorNames[0].c_str());
+        mOutputDims = mEngine->getTensorShape(mParams.outputTensorNames[0].c_str());
         
         return true;
     }
 
 
-    int Infer(std::vector<uint8_t>& inputData) {
+    int Infer(std::vector<uint8_t>& inputData, float* probabilities = nullptr) {
         // Create RAII buffer manager object
         BufferManager buffers(mEngine);
 
@@ -240,6 +202,10 @@ public:
 
         // Verify results
         auto result = verifyOutput(buffers);
+        if (probabilities) {
+            const float* output = static_cast<const float*>(buffers.getHostBuffer(mParams.outputTensorNames[0]));
+            memcpy(probabilities, output, mOutputDims.d[1] * sizeof(float));
+        }
 
         return result;
     }
@@ -252,17 +218,11 @@ public:
         const int inputH = mInputDims.d[2];
         const int inputW = mInputDims.d[3];
 
-        std::cout << "Input:" << std::endl;
-        for (int i = 0; i < inputH * inputW; i++) {
-            std::cout << (" .:-=+*#%@"[inputData[i] / 26]) << (((i + 1) % inputW) ? "" : "\n");
+        if (mParams.print) {
+            printDigit(std::cout, inputData.data(), inputH, inputW);
         }
-        std::cout << std::endl;
-
         float* hostDataBuffer = static_cast<float*>(buffers.getHostBuffer(mParams.inputTensorNames[0]));
-        for (int i = 0; i < inputH * inputW; i++) {
-            hostDataBuffer[i] = 1.0 - float(inputData[i] / 255.0);
-        }
-
+        normalizeDigit(inputData.data(), inputH * inputW, hostDataBuffer);
         return true;
     }
 
@@ -275,38 +235,68 @@ public:
     {
         const int outputSize = mOutputDims.d[1];
         float* output = static_cast<float*>(buffers.getHostBuffer(mParams.outputTensorNames[0]));
-        float val{0.0F};
-        int idx{0};
-
-        // Calculate Softmax
-        float sum{0.0F};
-        for (int i = 0; i < outputSize; i++) {
-            output[i] = exp(output[i]);
-            sum += output[i];
+        const int idx = softmaxArgmax(output, outputSize);
+        if (mParams.print) {
+            printProbabilities(std::cout, output, outputSize);
         }
+        return idx;
+    }
 
-        // sample::gLogInfo << "Output:" << std::endl;
-        for (int i = 0; i < outputSize; i++) {
-            output[i] /= sum;
-            val = std::max(val, output[i]);
-            if (val == output[i]) {
-                idx = i;
+    //!
+    //! \brief Classifies count images stored back to back in pixels with one execution context and one stream:
+    //!        the batch is copied to the device and back in one transfer each and synchronized once. The engine's
+    //!        input has a fixed batch of 1, so the network is enqueued once per image on slices of the buffers.
+    //!
+    bool InferBatch(const uint8_t* pixels, int count, int* results) {
+        const size_t inputSize = static_cast<size_t>(mInputDims.d[2]) * mInputDims.d[3];
+        const size_t outputSize = static_cast<size_t>(mOutputDims.d[1]);
+        auto context = std::unique_ptr<nvinfer1::IExecutionContext>(mEngine->createExecutionContext());
+        if (!context) {
+            return false;
+        }
+
+        HostBuffer hostInput(count * inputSize, DataType::kFLOAT);
+        HostBuffer hostOutput(count * outputSize, DataType::kFLOAT);
+        DeviceBuffer deviceInput(count * inputSize, DataType::kFLOAT);
+        DeviceBuffer deviceOutput(count * outputSize, DataType::kFLOAT);
+        float* input = static_cast<float*>(hostInput.data());
+        for (int i = 0; i < count; i++) {
+            if (mParams.print) {
+                printDigit(std::cout, pixels + i * inputSize, mInputDims.d[2], mInputDims.d[3]);
             }
-            /*
-            sample::gLogInfo << " Prob " << i << "  " << std::fixed << std::setw(5) << std::setprecision(4) << output[i]
-                            << " "
-                            << "Class " << i << ": " << std::string(int(std::floor(output[i] * 10 + 0.5F)), '*')
-                            << std::endl;
-            */
-            std::cout << " Prob " << i << "  " << std::fixed << std::setw(5) << std::setprecision(4) << output[i]
-                            << " "
-                            << "Class " << i << ": " << std::string(int(std::floor(output[i] * 10 + 0.5F)), '*')
-                            << std::endl;
+            normalizeDigit(pixels + i * inputSize, static_cast<int>(inputSize), input + i * inputSize);
         }
-        //sample::gLogInfo << std::endl;
-        std::cout << std::endl;
 
-        return idx;
+        cudaStream_t stream;
+        if (cudaStreamCreate(&stream) != cudaSuccess) {
+            return false;
+        }
+        const char* inputName = mParams.inputTensorNames[0].c_str();
+        const char* outputName = mParams.outputTensorNames[0].c_str();
+        bool ok = cudaMemcpyAsync(deviceInput.data(), hostInput.data(), hostInput.nbBytes(), cudaMemcpyHostToDevice,
+                      stream) == cudaSuccess;
+        for (int i = 0; ok && i < count; i++) {
+            // Addresses are read when the work is enqueued, so the next image can rebind them right away
+            ok = context->setTensorAddress(inputName, static_cast<float*>(deviceInput.data()) + i * inputSize)
+                && context->setTensorAddress(outputName, static_cast<float*>(deviceOutput.data()) + i * outputSize)
+                && context->enqueueV3(stream);
+        }
+        ok = ok && cudaMemcpyAsync(hostOutput.data(), deviceOutput.data(), hostOutput.nbBytes(),
+                       cudaMemcpyDeviceToHost, stream) == cudaSuccess;
+        ok = cudaStreamSynchronize(stream) == cudaSuccess && ok;
+        cudaStreamDestroy(stream);
+        if (!ok) {
+            return false;
+        }
+
+        float* output = static_cast<float*>(hostOutput.data());
+        for (int i = 0; i < count; i++) {
+            results[i] = softmaxArgmax(output + i * outputSize, static_cast<int>(outputSize));
+            if (mParams.print) {
+                printProbabilities(std::cout, output + i * outputSize, static_cast<int>(outputSize));
+            }
+        }
+        return true;
     }
 
     Dims getInputDims() {
@@ -317,30 +307,60 @@ public:
         return mOutputDims;
     }
 
+    //!
+    //! \brief Estimated footprint: the engine's weights (about the plan size) and activations live on the device;
+    //!        every inference allocates input and output buffers on both sides.
+    //!
+    ModelMemory memoryUsage() const {
+        auto bytes = [](const Dims& dims) {
+            size_t n = sizeof(float);
+            for (int32_t i = 0; i < dims.nbDims; i++) {
+                n *= static_cast<size_t>(std::max<int64_t>(dims.d[i], 1));
+            }
+            return n;
+        };
+        ModelMemory memory;
+        const size_t io = bytes(mInputDims) + bytes(mOutputDims);
+        memory.hostBytes = io;
+        memory.deviceBytes = mPlanBytes + (mEngine ? mEngine->getDeviceMemorySize() : 0) + io;
+        return memory;
+    }
+
 public:
     Inference(): mRuntime(nullptr) {}  
     std::shared_ptr<IRuntime> mRuntime;
     std::shared_ptr<ICudaEngine> mEngine;
     Dims mInputDims;  //!< The dimensions of the input to the network.
     Dims mOutputDims; //!< The dimensions of the output to the network.
+    size_t mPlanBytes{0}; //!< Size of the serialized engine.
 
     ModelParams mParams;
 };
 
-std::unique_ptr<std::vector<uint8_t>> getTestData(ModelParams& params, int inputH, int inputW) {
-    auto fileData = std::make_unique<std::vector<uint8_t>>(inputH * inputW);
-    int number = rand() % 10;
-    readPGMFile(locateFile(std::to_string(number) + ".pgm", params.dataDirs), fileData->data(), inputH, inputW);
-    return fileData;
+MnistApi::~MnistApi() {
+    delete static_cast<Inference *>(mModel);
+}
+
+MnistApi::MnistApi(std::string planCache, bool print)
+    : mPlanCache(std::move(planCache))
+    , mPrint(print)
+{
 }
 
 bool MnistApi::load() {
     auto params = initializeModelParams();
+    params.planCache = mPlanCache;
+    params.print = mPrint;
     Inference *inference = new Inference();
+    delete static_cast<Inference *>(mModel);
     mModel = inference;
     return inference->Build(params);
 }
 
+ModelMemory MnistApi::memoryUsage() const {
+    return mModel ? static_cast<const Inference *>(mModel)->memoryUsage() : ModelMemory();
+}
+
 int MnistApi::infer(const char*data) {
     auto inference = static_cast<Inference *>(this->mModel);
     auto inputDims = inference->getInputDims();
@@ -352,24 +372,24 @@ int MnistApi::infer(const char*data) {
     return inference->Infer(*input);
 }
 
-
-#if 0
-int main(int argc, char *argv[]) {
-
-    Inference inference;
-    // Create a TensorRT runtime
-    auto params = initializeModelParams();
-    inference.Build(params);
-
-    srand(unsigned(time(nullptr)));
-
-    auto inputDims = inference.getInputDims();
+int MnistApi::inferProbabilities(const char *data, float *probabilities) {
+    auto inference = static_cast<Inference *>(this->mModel);
+    auto inputDims = inference->getInputDims();
     const int inputH = inputDims.d[2];
     const int inputW = inputDims.d[3];
 
-    for (int i = 0; i < 3; i++) {
-        auto testData = getTestData(params, inputH, inputW);
-        auto res = inference.Infer(*testData);
+    auto input = std::make_unique<std::vector<uint8_t>>(inputH * inputW);
+    memcpy(input->data(), data, inputH * inputW);
+    return inference->Infer(*input, probabilities);
+}
+
+void MnistApi::inferBatch(const char *data, int count, int *results) {
+    if (count <= 0) {
+        return;
+    }
+    auto inference = static_cast<Inference *>(this->mModel);
+    if (!inference->InferBatch(reinterpret_cast<const uint8_t*>(data), count, results)) {
+        // Same answer as a failed infer(), which returns false
+        std::fill(results, results + count, 0);
     }
 }
-#endif
\ No newline at end of file
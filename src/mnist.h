@@ -1,9 +1,24 @@
+#pragma once
+
+#include <string>
 #include "model.h"
 
 class MnistApi: public Model {
 public:
+    //!
+    //! \param planCache When set, the serialized engine is kept in this file (see PlanCache) and built only if
+    //!        it is missing or older than mnist.onnx.
+    //! \param print Print every input as ASCII art and its class probabilities, for debugging.
+    //!
+    explicit MnistApi(std::string planCache = "", bool print = false);
+    virtual ~MnistApi();
     virtual bool load();
     virtual int infer(const char *data);
+    virtual int inferProbabilities(const char *data, float *probabilities);
+    virtual void inferBatch(const char *data, int count, int *results);
+    virtual ModelMemory memoryUsage() const;
 public:
-    void *mModel; 
-};
\ No newline at end of file
+    void *mModel{nullptr};
+    std::string mPlanCache;
+    bool mPrint;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+//!
+//! Host-side input and output processing of the TensorRT MNIST path (Inference::processInput and
+//! Inference::verifyOutput), kept free of CUDA so that it can be benchmarked without a GPU.
+//!
+
+//!
+//! \brief Draws an 8-bit image as ASCII art, one line per row.
+//!
+inline void printDigit(std::ostream& out, const uint8_t* pixels, int h, int w) {
+    out << "Input:" << std::endl;
+    for (int i = 0; i < h * w; i++) {
+        out << (" .:-=+*#%@"[pixels[i] / 26]) << (((i + 1) % w) ? "" : "\n");
+    }
+    out << std::endl;
+}
+
+//!
+//! \brief Converts pixels to the network's input: 1 - p / 255, so the white background becomes 0.
+//!
+inline void normalizeDigit(const uint8_t* pixels, int count, float* input) {
+    for (int i = 0; i < count; i++) {
+        input[i] = 1.0 - float(pixels[i] / 255.0);
+    }
+}
+
+//!
+//! \brief Replaces the logits by their softmax and returns the most probable class (the last one on ties).
+//!
+inline int softmaxArgmax(float* values, int count) {
+    // Shifted by the largest logit so that exp() cannot overflow
+    const float maxLogit = count > 0 ? *std::max_element(values, values + count) : 0.0F;
+    float sum{0.0F};
+    for (int i = 0; i < count; i++) {
+        values[i] = std::exp(values[i] - maxLogit);
+        sum += values[i];
+    }
+    float val{0.0F};
+    int idx{0};
+    for (int i = 0; i < count; i++) {
+        values[i] /= sum;
+        val = std::max(val, values[i]);
+        if (val == values[i]) {
+            idx = i;
+        }
+    }
+    return idx;
+}
+
+//!
+//! \brief Prints every class probability with a bar of up to ten stars.
+//!
+inline void printProbabilities(std::ostream& out, const float* probabilities, int count) {
+    for (int i = 0; i < count; i++) {
+        out << " Prob " << i << "  " << std::fixed << std::setw(5) << std::setprecision(4) << probabilities[i] << " "
+            << "Class " << i << ": " << std::string(int(std::floor(probabilities[i] * 10 + 0.5F)), '*')
+            << std::endl;
+    }
+    out << std::endl;
+}
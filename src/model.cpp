@@ -0,0 +1,69 @@
+#include "model.h"
+#include <sstream>
+#include "cpu_mnist.h"
+#include "sim_model.h"
+#ifdef WITH_TENSORRT
+#include "mnist.h"
+#endif
+
+bool parseModelSpec(const std::string& spec, std::string& backend, std::map<std::string, std::string>& options) {
+    size_t colon = spec.find(':');
+    backend = spec.substr(0, colon);
+    options.clear();
+    if (colon == std::string::npos) {
+        return !backend.empty();
+    }
+    std::stringstream ss(spec.substr(colon + 1));
+    std::string option;
+    while (std::getline(ss, option, ',')) {
+        size_t eq = option.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            return false;
+        }
+        options[option.substr(0, eq)] = option.substr(eq + 1);
+    }
+    return !backend.empty();
+}
+
+std::unique_ptr<Model> createModel(const std::string& spec, int threads) {
+    std::string backend;
+    std::map<std::string, std::string> options;
+    if (!parseModelSpec(spec, backend, options)) {
+        return nullptr;
+    }
+    if (backend == "sim") {
+        SimulatedModelParams params;
+        if (!SimulatedModel::parseParams(options, params)) {
+            return nullptr;
+        }
+        return std::make_unique<SimulatedModel>(params);
+    }
+    // cpu and tensorrt only take the file their prepared weights or engine are shared through, and tensorrt a
+    // debug switch that prints every input and its probabilities
+    std::string planCache;
+    auto it = options.find("plan_cache");
+    if (it != options.end()) {
+        planCache = it->second;
+        options.erase(it);
+    }
+#ifdef WITH_TENSORRT
+    bool print = false;
+    it = options.find("print");
+    if (backend == "tensorrt" && it != options.end()) {
+        print = it->second == "1";
+        options.erase(it);
+    }
+#endif
+    if (!options.empty()) {
+        return nullptr;
+    }
+    if (backend == "cpu") {
+        return std::make_unique<CpuMnistApi>(threads, planCache);
+    }
+#ifdef WITH_TENSORRT
+    if (backend == "tensorrt") {
+        return std::make_unique<MnistApi>(planCache, print);
+    }
+#endif
+    return nullptr;
+}
@@ -1,6 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+//!
+//! \brief Memory a loaded model keeps resident.
+//!
+struct ModelMemory {
+    size_t hostBytes{0};
+    size_t deviceBytes{0};
+};
 
 class Model {
 public:
+    virtual ~Model() = default;
     virtual bool load() = 0;
     virtual int infer(const char *data) = 0;
-};
\ No newline at end of file
+
+    //!
+    //! \brief Number of bytes in one input image (8-bit grayscale, PGM polarity).
+    //!
+    virtual int inputSize() const {
+        return 28 * 28;
+    }
+
+    //!
+    //! \brief Number of classes the model scores.
+    //!
+    virtual int classCount() const {
+        return 10;
+    }
+
+    //!
+    //! \brief Classifies one image and writes classCount() class probabilities. Backends that cannot report
+    //!        probabilities fall back to a one-hot vector.
+    //!
+    virtual int inferProbabilities(const char *data, float *probabilities) {
+        int result = infer(data);
+        for (int i = 0; i < classCount(); i++) {
+            probabilities[i] = i == result ? 1.0F : 0.0F;
+        }
+        return result;
+    }
+
+    //!
+    //! \brief Memory held by the loaded model (weights, engine, buffers), as used for memory budgets. Only
+    //!        meaningful after load().
+    //!
+    virtual ModelMemory memoryUsage() const {
+        return {};
+    }
+
+    //!
+    //! \brief Classifies count images stored back to back in data. Backends that can run a real batch
+    //!        override this; the default runs them one by one.
+    //!
+    virtual void inferBatch(const char *data, int count, int *results) {
+        for (int i = 0; i < count; i++) {
+            results[i] = infer(data + static_cast<size_t>(i) * inputSize());
+        }
+    }
+};
+
+#ifdef WITH_TENSORRT
+static const char kDefaultBackend[] = "tensorrt";
+#else
+static const char kDefaultBackend[] = "cpu";
+#endif
+
+//!
+//! \brief Splits a backend spec of the form "backend[:key=value,...]", e.g. "sim:latency_us=500,classes=10".
+//!
+bool parseModelSpec(const std::string& spec, std::string& backend, std::map<std::string, std::string>& options);
+
+//!
+//! \brief Creates an unloaded model from a backend spec: "tensorrt[:plan_cache=path,print=1]",
+//!        "cpu[:plan_cache=path]" or "sim[:options]" (see SimulatedModel::parseParams and PlanCache). print=1 makes
+//!        tensorrt print every input and its probabilities. Returns nullptr if the spec is invalid or the backend
+//!        was not compiled in. threads is the number of CPU threads a backend may use for one batch.
+//!
+std::unique_ptr<Model> createModel(const std::string& spec, int threads = 1);
@@ -0,0 +1,154 @@
+#include "model_repository.h"
+
+ModelRepository::ModelRepository(const MemoryBudget& budget, Metrics* metrics, Factory factory)
+    : mBudget(budget)
+    , mFactory(factory ? std::move(factory) : [](const std::string& spec) { return createModel(spec); })
+{
+    if (metrics) {
+        mLoadsMetric = &metrics->counter("tensorrt_model_loads_total", "Models loaded on demand");
+        mEvictionsMetric = &metrics->counter("tensorrt_model_evictions_total", "Idle models unloaded for memory");
+        mFailuresMetric = &metrics->counter("tensorrt_model_load_failures_total", "Model loads that failed");
+        mLoadedMetric = &metrics->gauge("tensorrt_models_loaded", "Models currently loaded");
+        const std::string memoryHelp = "Memory used by loaded models";
+        mHostBytesMetric = &metrics->gauge("tensorrt_model_memory_bytes{kind=\"host\"}", memoryHelp);
+        mDeviceBytesMetric = &metrics->gauge("tensorrt_model_memory_bytes{kind=\"device\"}", memoryHelp);
+    }
+}
+
+ModelRepository::~ModelRepository() = default;
+
+bool ModelRepository::add(const std::string& name, const std::string& spec) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mEntries.count(name)) {
+        return false;
+    }
+    auto entry = std::make_unique<Entry>();
+    entry->name = name;
+    entry->spec = spec;
+    mEntries.emplace(name, std::move(entry));
+    return true;
+}
+
+ModelRepository::Lease ModelRepository::acquire(const std::string& name) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto it = mEntries.find(name);
+    if (it == mEntries.end()) {
+        return Lease();
+    }
+    Entry* entry = it->second.get();
+
+    while (entry->state != State::kUNLOADED) {
+        if (entry->state == State::kLOADED) {
+            entry->leases++;
+            entry->lastUsed = ++mClock;
+            return Lease(this, entry);
+        }
+        const int attempt = entry->attempts;
+        mLoadDone.wait(lock, [entry]() { return entry->state != State::kLOADING; });
+        if (entry->state == State::kUNLOADED && entry->attempts == attempt && entry->failed) {
+            return Lease(); // every request that waited for a failed load fails with it, without retrying
+        }
+    }
+
+    // Load it ourselves, making room first if the footprint is known from an earlier load
+    entry->state = State::kLOADING;
+    entry->attempts++;
+    auto victims = evict(entry->known ? entry->memory : ModelMemory(), entry);
+    lock.unlock();
+    victims.clear();
+    auto model = mFactory(entry->spec);
+    const bool loaded = model && model->load();
+    const ModelMemory memory = loaded ? model->memoryUsage() : ModelMemory();
+    lock.lock();
+
+    if (!loaded) {
+        entry->state = State::kUNLOADED;
+        entry->failed = true;
+        mStats.loadFailures++;
+        publish();
+        mLoadDone.notify_all();
+        return Lease();
+    }
+    entry->model = std::move(model);
+    entry->memory = memory;
+    entry->known = true;
+    entry->failed = false;
+    entry->state = State::kLOADED;
+    entry->leases++;
+    entry->lastUsed = ++mClock;
+    mStats.loads++;
+    mStats.loaded++;
+    mStats.used.hostBytes += memory.hostBytes;
+    mStats.used.deviceBytes += memory.deviceBytes;
+    victims = evict(ModelMemory(), entry);
+    publish();
+    mLoadDone.notify_all();
+    lock.unlock();
+    return Lease(this, entry);
+}
+
+void ModelRepository::release(Entry* entry) {
+    std::vector<std::unique_ptr<Model>> victims;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        entry->leases--;
+        entry->lastUsed = ++mClock;
+        // Models that could not be evicted while leased go now
+        victims = evict(ModelMemory(), nullptr);
+        if (!victims.empty()) {
+            publish();
+        }
+    }
+}
+
+bool ModelRepository::overBudget(const ModelMemory& extra) const {
+    return (mBudget.hostBytes && mStats.used.hostBytes + extra.hostBytes > mBudget.hostBytes)
+        || (mBudget.deviceBytes && mStats.used.deviceBytes + extra.deviceBytes > mBudget.deviceBytes);
+}
+
+std::vector<std::unique_ptr<Model>> ModelRepository::evict(const ModelMemory& extra, const Entry* keep) {
+    std::vector<std::unique_ptr<Model>> victims;
+    while (overBudget(extra)) {
+        Entry* oldest = nullptr;
+        for (const auto& it : mEntries) {
+            Entry* candidate = it.second.get();
+            if (candidate != keep && candidate->state == State::kLOADED && candidate->leases == 0
+                && (!oldest || candidate->lastUsed < oldest->lastUsed)) {
+                oldest = candidate;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        victims.push_back(std::move(oldest->model));
+        oldest->state = State::kUNLOADED;
+        mStats.evictions++;
+        mStats.loaded--;
+        mStats.used.hostBytes -= oldest->memory.hostBytes;
+        mStats.used.deviceBytes -= oldest->memory.deviceBytes;
+    }
+    return victims;
+}
+
+void ModelRepository::publish() {
+    if (!mLoadsMetric) {
+        return;
+    }
+    *mLoadsMetric = mStats.loads;
+    *mEvictionsMetric = mStats.evictions;
+    *mFailuresMetric = mStats.loadFailures;
+    *mLoadedMetric = mStats.loaded;
+    *mHostBytesMetric = static_cast<int64_t>(mStats.used.hostBytes);
+    *mDeviceBytesMetric = static_cast<int64_t>(mStats.used.deviceBytes);
+}
+
+ModelRepository::Stats ModelRepository::stats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+bool ModelRepository::isLoaded(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(name);
+    return it != mEntries.end() && it->second->state == State::kLOADED;
+}
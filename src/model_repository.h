@@ -0,0 +1,168 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "model.h"
+
+//!
+//! \brief Host and device memory the loaded models may use together; 0 means no limit.
+//!
+struct MemoryBudget {
+    size_t hostBytes{0};
+    size_t deviceBytes{0};
+};
+
+//!
+//! \brief Named models that are loaded on first use and evicted, least recently used first, to stay within a
+//!        memory budget.
+//!
+//! Models are registered with a backend spec and created by the factory (createModel by default) when first
+//! acquired. A Lease keeps its model loaded; only models without leases are evicted. Concurrent requests for
+//! a model that is being loaded wait for that load instead of starting another one. Before loading a model
+//! whose footprint is known from an earlier load, idle models are evicted to make room for it; after every
+//! load the footprint reported by Model::memoryUsage() is accounted and the budget enforced again. The budget
+//! can therefore only be exceeded while every other loaded model is leased.
+//!
+class ModelRepository {
+public:
+    using Factory = std::function<std::unique_ptr<Model>(const std::string& spec)>;
+
+    class Lease;
+
+    //!
+    //! \param metrics Receives load, eviction and memory series when not null.
+    //!
+    explicit ModelRepository(const MemoryBudget& budget, Metrics* metrics = nullptr, Factory factory = nullptr);
+    ~ModelRepository();
+
+    ModelRepository(const ModelRepository&) = delete;
+    ModelRepository& operator=(const ModelRepository&) = delete;
+
+    //!
+    //! \brief Registers a model without loading it. Returns false if the name is taken.
+    //!
+    bool add(const std::string& name, const std::string& spec);
+
+    //!
+    //! \brief Returns the named model, loading it first if needed. The lease is empty if the model is unknown or
+    //!        failed to load.
+    //!
+    Lease acquire(const std::string& name);
+
+    struct Stats {
+        int64_t loads{0};
+        int64_t evictions{0};
+        int64_t loadFailures{0};
+        int loaded{0};
+        ModelMemory used;
+    };
+
+    Stats stats() const;
+    bool isLoaded(const std::string& name) const;
+
+private:
+    enum class State {
+        kUNLOADED,
+        kLOADING,
+        kLOADED,
+    };
+
+    struct Entry {
+        std::string name;
+        std::string spec;
+        State state{State::kUNLOADED};
+        std::unique_ptr<Model> model;
+        int leases{0};
+        uint64_t lastUsed{0};
+        ModelMemory memory; //!< Footprint of the last successful load.
+        bool known{false};  //!< memory is valid.
+        int attempts{0};    //!< Loads started, so waiters can tell whether the load they waited for failed.
+        bool failed{false};
+    };
+
+    void release(Entry* entry);
+
+    //!
+    //! \brief Unloads idle models, least recently used first, until the loaded models plus extra fit the budget.
+    //!        Returns the evicted models so they can be destroyed outside the lock.
+    //!
+    std::vector<std::unique_ptr<Model>> evict(const ModelMemory& extra, const Entry* keep);
+    bool overBudget(const ModelMemory& extra) const;
+    void publish();
+
+    MemoryBudget mBudget;
+    Factory mFactory;
+    mutable std::mutex mMutex;
+    std::condition_variable mLoadDone;
+    std::map<std::string, std::unique_ptr<Entry>> mEntries;
+    uint64_t mClock{0};
+    Stats mStats;
+
+    std::atomic<int64_t>* mLoadsMetric{nullptr};
+    std::atomic<int64_t>* mEvictionsMetric{nullptr};
+    std::atomic<int64_t>* mFailuresMetric{nullptr};
+    std::atomic<int64_t>* mLoadedMetric{nullptr};
+    std::atomic<int64_t>* mHostBytesMetric{nullptr};
+    std::atomic<int64_t>* mDeviceBytesMetric{nullptr};
+};
+
+//!
+//! \brief Keeps a model loaded while held. Move-only; releasing the last lease makes the model evictable.
+//!
+class ModelRepository::Lease {
+public:
+    Lease() = default;
+    Lease(Lease&& other) noexcept
+        : mRepository(other.mRepository)
+        , mEntry(other.mEntry)
+    {
+        other.mEntry = nullptr;
+    }
+    Lease& operator=(Lease&& other) noexcept {
+        if (this != &other) {
+            reset();
+            mRepository = other.mRepository;
+            mEntry = other.mEntry;
+            other.mEntry = nullptr;
+        }
+        return *this;
+    }
+    ~Lease() {
+        reset();
+    }
+
+    Model* get() const {
+        return mEntry ? mEntry->model.get() : nullptr;
+    }
+    Model* operator->() const {
+        return get();
+    }
+    explicit operator bool() const {
+        return mEntry != nullptr;
+    }
+
+    void reset() {
+        if (mEntry) {
+            mRepository->release(mEntry);
+            mEntry = nullptr;
+        }
+    }
+
+private:
+    friend class ModelRepository;
+    Lease(ModelRepository* repository, Entry* entry)
+        : mRepository(repository)
+        , mEntry(entry)
+    {
+    }
+
+    ModelRepository* mRepository{nullptr};
+    Entry* mEntry{nullptr};
+};
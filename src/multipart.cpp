@@ -0,0 +1,189 @@
+#include "multipart.h"
+
+#include <cstring>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && isSpace(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (isSpace(text.back()) || text.back() == '\r')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') {
+            x = static_cast<char>(x - 'A' + 'a');
+        }
+        if (y >= 'A' && y <= 'Z') {
+            y = static_cast<char>(y - 'A' + 'a');
+        }
+        if (x != y) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//!
+//! \brief Finds key in a header value of the form "token; key=value; key2=\"value 2\"".
+//!
+bool findParam(std::string_view text, std::string_view key, std::string_view& value) {
+    while (!text.empty()) {
+        const size_t semicolon = text.find(';');
+        std::string_view item = trim(text.substr(0, semicolon));
+        text = semicolon == std::string_view::npos ? std::string_view() : text.substr(semicolon + 1);
+        const size_t eq = item.find('=');
+        if (eq == std::string_view::npos || !equalsIgnoreCase(trim(item.substr(0, eq)), key)) {
+            continue;
+        }
+        value = trim(item.substr(eq + 1));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool MultipartPart::header(std::string_view name, std::string_view& value) const {
+    std::string_view rest = headers;
+    while (!rest.empty()) {
+        const size_t eol = rest.find("\r\n");
+        std::string_view line = rest.substr(0, eol);
+        rest = eol == std::string_view::npos ? std::string_view() : rest.substr(eol + 2);
+        const size_t colon = line.find(':');
+        if (colon != std::string_view::npos && equalsIgnoreCase(trim(line.substr(0, colon)), name)) {
+            value = trim(line.substr(colon + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MultipartPart::param(std::string_view headerName, std::string_view key, std::string_view& value) const {
+    std::string_view text;
+    return header(headerName, text) && findParam(text, key, value);
+}
+
+std::string_view MultipartPart::name() const {
+    std::string_view value;
+    return param("Content-Disposition", "name", value) ? value : std::string_view();
+}
+
+MultipartReader::MultipartReader(std::string_view body, std::string_view boundary)
+    : mBody(body)
+    , mBoundary(boundary)
+{
+    if (boundary.empty()) {
+        mFailed = mDone = true;
+        return;
+    }
+    // The first delimiter has no CRLF before it when there is no preamble
+    if (body.size() >= boundary.size() + 2 && body.compare(0, 2, "--") == 0
+        && body.compare(2, boundary.size(), boundary) == 0) {
+        mPos = 2 + boundary.size();
+        return;
+    }
+    const size_t delimiter = findDelimiter(0);
+    if (delimiter == std::string_view::npos) {
+        mFailed = mDone = true;
+        return;
+    }
+    mPos = delimiter + 4 + boundary.size();
+}
+
+size_t MultipartReader::findDelimiter(size_t from) const {
+    const size_t length = 4 + mBoundary.size();
+    const char* data = mBody.data();
+    const char* end = data + mBody.size();
+    const char* p = data + from;
+    auto matches = [this](const char* at) {
+        return at[2] == '-' && at[3] == '-' && memcmp(at + 4, mBoundary.data(), mBoundary.size()) == 0;
+    };
+    while (end - p >= static_cast<ptrdiff_t>(length)) {
+        p = static_cast<const char*>(memchr(p, '\r', static_cast<size_t>(end - p) - length + 1));
+        if (!p) {
+            break;
+        }
+        if (p[1] == '\n' && matches(p)) {
+            return static_cast<size_t>(p - data);
+        }
+        p++;
+    }
+    return std::string_view::npos;
+}
+
+bool MultipartReader::next(MultipartPart& part) {
+    if (mDone) {
+        return false;
+    }
+    // After a delimiter: "--" closes the body, otherwise optional whitespace and CRLF start a part
+    if (mBody.compare(mPos, 2, "--") == 0) {
+        mDone = true;
+        return false;
+    }
+    while (mPos < mBody.size() && isSpace(mBody[mPos])) {
+        mPos++;
+    }
+    if (mBody.compare(mPos, 2, "\r\n") != 0) {
+        mFailed = mDone = true;
+        return false;
+    }
+    mPos += 2;
+
+    size_t bodyStart;
+    if (mBody.compare(mPos, 2, "\r\n") == 0) {
+        part.headers = std::string_view();
+        bodyStart = mPos + 2;
+    } else {
+        const size_t blank = mBody.find("\r\n\r\n", mPos);
+        if (blank == std::string_view::npos) {
+            mFailed = mDone = true;
+            return false;
+        }
+        part.headers = mBody.substr(mPos, blank - mPos);
+        bodyStart = blank + 4;
+    }
+    const size_t delimiter = findDelimiter(bodyStart);
+    if (delimiter == std::string_view::npos) {
+        mFailed = mDone = true;
+        return false;
+    }
+    part.body = mBody.substr(bodyStart, delimiter - bodyStart);
+    mPos = delimiter + 4 + mBoundary.size();
+    return true;
+}
+
+bool multipartBoundary(std::string_view contentType, std::string_view& boundary) {
+    const size_t semicolon = contentType.find(';');
+    if (!equalsIgnoreCase(trim(contentType.substr(0, semicolon)), "multipart/form-data")
+        || semicolon == std::string_view::npos) {
+        return false;
+    }
+    return findParam(contentType.substr(semicolon + 1), "boundary", boundary) && !boundary.empty();
+}
+
+bool findMultipartPart(std::string_view body, std::string_view boundary, std::string_view name, MultipartPart& part) {
+    MultipartReader reader(body, boundary);
+    while (reader.next(part)) {
+        if (part.name() == name) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+//!
+//! \brief One part of a multipart/form-data body. Both views point into the request body; nothing is copied and
+//!        headers are only parsed when asked for.
+//!
+struct MultipartPart {
+    std::string_view headers; //!< Raw header lines separated by CRLF, without the blank line ending them.
+    std::string_view body;
+
+    //!
+    //! \brief Finds a header by name, ignoring case, and sets value to it without surrounding whitespace.
+    //!
+    bool header(std::string_view name, std::string_view& value) const;
+
+    //!
+    //! \brief Finds a parameter of a header, e.g. param("Content-Disposition", "filename", value); surrounding
+    //!        quotes are removed.
+    //!
+    bool param(std::string_view headerName, std::string_view key, std::string_view& value) const;
+
+    //!
+    //! \brief The form field name from Content-Disposition, empty if there is none.
+    //!
+    std::string_view name() const;
+};
+
+//!
+//! \brief Walks the parts of a multipart/form-data body one at a time.
+//!
+//! The body is scanned once: each delimiter ("\r\n--" + boundary) is found with memchr for its first byte, which
+//! the C library vectorizes, followed by a compare. Reading stops wherever the caller stops calling next(), so a
+//! handler looking for one part never touches the bytes after it.
+//!
+class MultipartReader {
+public:
+    MultipartReader(std::string_view body, std::string_view boundary);
+
+    //!
+    //! \brief Moves to the next part. Returns false after the last one, or if the body is malformed (see failed()).
+    //!
+    bool next(MultipartPart& part);
+
+    bool failed() const {
+        return mFailed;
+    }
+
+private:
+    //!
+    //! \brief Position of the next "\r\n--boundary" at or after from, or npos.
+    //!
+    size_t findDelimiter(size_t from) const;
+
+    std::string_view mBody;
+    std::string_view mBoundary;
+    size_t mPos{0}; //!< Just after the last delimiter read.
+    bool mDone{false};
+    bool mFailed{false};
+};
+
+//!
+//! \brief Extracts the boundary parameter from a multipart Content-Type header value.
+//!
+bool multipartBoundary(std::string_view contentType, std::string_view& boundary);
+
+//!
+//! \brief Finds the first part with the given field name, reading the body only up to its end.
+//!
+bool findMultipartPart(std::string_view body, std::string_view boundary, std::string_view name, MultipartPart& part);
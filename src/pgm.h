@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline std::unique_ptr<std::vector<uint8_t>> parsePGMData(const std::string& pgm) {
+    std::string magic, w, h, max;
+    auto istrream = std::istringstream(pgm);
+    istrream >> magic >> w >> h >> max;
+    istrream.seekg(1, istrream.cur);
+    auto data = std::make_unique<std::vector<uint8_t>>(std::stoi(w) * std::stoi(h));
+
+    istrream.read(reinterpret_cast<char*>(data->data()), std::stoi(w) * std::stoi(h));
+    return data;
+}
+
+//!
+//! \brief Parses the header of a binary (P5) PGM held in memory. On success w and h are the image size and
+//!        offset is where the 8-bit raster starts; the raster is known to be complete.
+//!
+inline bool parsePGMHeader(std::string_view pgm, int& w, int& h, size_t& offset) {
+    size_t pos = 0;
+    auto skipSpace = [&]() {
+        while (pos < pgm.size() && (isspace(static_cast<unsigned char>(pgm[pos])) || pgm[pos] == '#')) {
+            if (pgm[pos] == '#') {
+                while (pos < pgm.size() && pgm[pos] != '\n') {
+                    pos++;
+                }
+            } else {
+                pos++;
+            }
+        }
+    };
+    auto number = [&]() {
+        skipSpace();
+        int value = 0;
+        bool any = false;
+        while (pos < pgm.size() && pgm[pos] >= '0' && pgm[pos] <= '9' && value < 65536) {
+            value = value * 10 + (pgm[pos++] - '0');
+            any = true;
+        }
+        return any ? value : -1;
+    };
+    if (pgm.size() < 2 || pgm[0] != 'P' || pgm[1] != '5') {
+        return false;
+    }
+    pos = 2;
+    w = number();
+    h = number();
+    const int max = number();
+    if (w <= 0 || h <= 0 || max <= 0 || max > 255) {
+        return false;
+    }
+    pos++; // single whitespace before the raster
+    offset = pos;
+    return pos <= pgm.size() && pgm.size() - pos >= static_cast<size_t>(w) * h;
+}
+
+//!
+//! \brief Decodes a binary (P5) PGM held in memory into out, which must hold inH x inW bytes. Unlike
+//!        parsePGMData this validates the header and does not allocate.
+//!
+inline bool decodePGM(std::string_view pgm, uint8_t* out, int inH, int inW) {
+    int w, h;
+    size_t offset;
+    if (!parsePGMHeader(pgm, w, h, offset) || w != inW || h != inH) {
+        return false;
+    }
+    memcpy(out, pgm.data() + offset, static_cast<size_t>(inH) * inW);
+    return true;
+}
+
+//!
+//! \brief Reads a binary (P5) PGM file of exactly inH x inW pixels into buffer.
+//!
+inline bool readPGMFile(const std::string& fileName, uint8_t* buffer, int inH, int inW) {
+    std::ifstream infile(fileName, std::ifstream::binary);
+    if (!infile.is_open()) {
+        return false;
+    }
+    std::string magic;
+    int w{0}, h{0}, max{0};
+    infile >> magic >> w >> h >> max;
+    if (magic != "P5" || w != inW || h != inH || max > 255) {
+        return false;
+    }
+    infile.seekg(1, infile.cur);
+    infile.read(reinterpret_cast<char*>(buffer), inH * inW);
+    return infile.gcount() == inH * inW;
+}
@@ -0,0 +1,448 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace {
+
+struct OpInfo {
+    const char* name;
+    PipelineOp op;
+    int minInputs;
+    int maxInputs;
+    std::set<std::string> required;
+    std::set<std::string> optional;
+};
+
+const std::vector<OpInfo>& opTable() {
+    static const std::vector<OpInfo> table = {
+        {"crop", PipelineOp::kCROP, 1, 1, {"x", "y", "w", "h"}, {}},
+        {"resize", PipelineOp::kRESIZE, 1, 1, {"h", "w"}, {}},
+        {"normalize", PipelineOp::kNORMALIZE, 1, 1, {}, {"min", "max"}},
+        {"model", PipelineOp::kMODEL, 1, 1, {"model"}, {}},
+        {"argmax", PipelineOp::kARGMAX, 1, 1, {}, {}},
+        {"concat", PipelineOp::kCONCAT, 1, 1 << 16, {}, {}},
+    };
+    return table;
+}
+
+size_t elements(const std::vector<int>& shape) {
+    size_t n = 1;
+    for (int dim : shape) {
+        n *= static_cast<size_t>(dim);
+    }
+    return n;
+}
+
+std::string shapeString(const std::vector<int>& shape) {
+    std::string s = "[";
+    for (size_t i = 0; i < shape.size(); i++) {
+        s += (i ? "," : "") + std::to_string(shape[i]);
+    }
+    return s + "]";
+}
+
+void crop(const Tensor& in, int x, int y, int w, int h, Tensor& out) {
+    const int inW = in.shape[1];
+    out.data.resize(static_cast<size_t>(h) * w);
+    for (int r = 0; r < h; r++) {
+        const float* src = in.data.data() + static_cast<size_t>(y + r) * inW + x;
+        std::copy(src, src + w, out.data.data() + static_cast<size_t>(r) * w);
+    }
+}
+
+void resize(const Tensor& in, int h, int w, Tensor& out) {
+    const int inH = in.shape[0];
+    const int inW = in.shape[1];
+    out.data.resize(static_cast<size_t>(h) * w);
+    // Pixel centres aligned, as in most image libraries
+    const float sy = static_cast<float>(inH) / h;
+    const float sx = static_cast<float>(inW) / w;
+    for (int r = 0; r < h; r++) {
+        const float fy = std::min(std::max((r + 0.5F) * sy - 0.5F, 0.0F), static_cast<float>(inH - 1));
+        const int y0 = static_cast<int>(fy);
+        const int y1 = std::min(y0 + 1, inH - 1);
+        const float wy = fy - y0;
+        for (int c = 0; c < w; c++) {
+            const float fx = std::min(std::max((c + 0.5F) * sx - 0.5F, 0.0F), static_cast<float>(inW - 1));
+            const int x0 = static_cast<int>(fx);
+            const int x1 = std::min(x0 + 1, inW - 1);
+            const float wx = fx - x0;
+            const float* row0 = in.data.data() + static_cast<size_t>(y0) * inW;
+            const float* row1 = in.data.data() + static_cast<size_t>(y1) * inW;
+            const float top = row0[x0] + (row0[x1] - row0[x0]) * wx;
+            const float bottom = row1[x0] + (row1[x1] - row1[x0]) * wx;
+            out.data[static_cast<size_t>(r) * w + c] = top + (bottom - top) * wy;
+        }
+    }
+}
+
+void normalize(const Tensor& in, float lo, float hi, Tensor& out) {
+    out.data.resize(in.data.size());
+    if (in.data.empty()) {
+        return;
+    }
+    const auto range = std::minmax_element(in.data.begin(), in.data.end());
+    const float inLo = *range.first;
+    const float inHi = *range.second;
+    const float scale = inHi > inLo ? (hi - lo) / (inHi - inLo) : 0.0F;
+    for (size_t i = 0; i < in.data.size(); i++) {
+        out.data[i] = lo + (in.data[i] - inLo) * scale;
+    }
+}
+
+} // namespace
+
+void Pipeline::execute(int index, std::vector<Tensor>& values) const {
+    const PipelineNode& node = mNodes[index];
+    Tensor& out = values[index];
+    out.shape = node.shape;
+    const Tensor& in = values[node.inputs.empty() ? 0 : node.inputs[0]];
+    auto param = [&](const char* key) { return node.params.at(key); };
+
+    switch (node.op) {
+    case PipelineOp::kINPUT:
+        break;
+    case PipelineOp::kCROP:
+        crop(in, static_cast<int>(param("x")), static_cast<int>(param("y")), node.shape[1], node.shape[0], out);
+        break;
+    case PipelineOp::kRESIZE:
+        resize(in, node.shape[0], node.shape[1], out);
+        break;
+    case PipelineOp::kNORMALIZE:
+        normalize(in, param("min"), param("max"), out);
+        break;
+    case PipelineOp::kMODEL: {
+        std::vector<uint8_t> pixels(in.data.size());
+        for (size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<uint8_t>(std::min(std::max(std::lround(in.data[i]), 0L), 255L));
+        }
+        out.data.resize(node.shape[0]);
+        node.model->inferProbabilities(reinterpret_cast<const char*>(pixels.data()), out.data.data());
+        break;
+    }
+    case PipelineOp::kARGMAX:
+        out.data.assign(1, static_cast<float>(std::max_element(in.data.begin(), in.data.end()) - in.data.begin()));
+        break;
+    case PipelineOp::kCONCAT:
+        out.data.clear();
+        out.data.reserve(node.shape[0]);
+        for (int input : node.inputs) {
+            out.data.insert(out.data.end(), values[input].data.begin(), values[input].data.end());
+        }
+        break;
+    }
+}
+
+//!
+//! \brief State of one concurrent run, shared by the tasks so it outlives whichever of them finishes last.
+//!
+struct Pipeline::RunState {
+    std::vector<Tensor> values;
+    std::vector<std::atomic<int>> pending; //!< Unfinished inputs per node.
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining{0};
+
+    explicit RunState(size_t nodes)
+        : values(nodes)
+        , pending(nodes)
+    {
+    }
+};
+
+void Pipeline::finished(const std::shared_ptr<RunState>& state, int index, ThreadPool& pool) const {
+    for (int consumer : mNodes[index].consumers) {
+        if (--state->pending[consumer] == 0) {
+            pool.submit([this, state, consumer, &pool]() {
+                execute(consumer, state->values);
+                finished(state, consumer, pool);
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (--state->remaining == 0) {
+                    state->done.notify_one();
+                }
+            });
+        }
+    }
+}
+
+Tensor Pipeline::run(const uint8_t* image, ThreadPool* pool) const {
+    auto state = std::make_shared<RunState>(mNodes.size());
+    std::vector<Tensor>& values = state->values;
+    values[0].shape = mNodes[0].shape;
+    values[0].data.assign(image, image + elements(mNodes[0].shape));
+
+    if (!pool || mNodes.size() <= 2) {
+        for (size_t i = 1; i < mNodes.size(); i++) {
+            execute(static_cast<int>(i), values);
+        }
+        return std::move(values[mOutput]);
+    }
+
+    // Whoever finishes the last input of a node schedules it. Each tensor is written by one task before its
+    // consumers are scheduled, so the values need no locking.
+    for (const auto& node : mNodes) {
+        for (int consumer : node.consumers) {
+            state->pending[consumer]++;
+        }
+    }
+    state->remaining = mNodes.size() - 1;
+    finished(state, 0, *pool);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->remaining == 0; });
+    return std::move(values[mOutput]);
+}
+
+PipelineRegistry::PipelineRegistry(int threads, std::vector<int> cpus) {
+    if (threads > 0) {
+        mPool = std::make_unique<ThreadPool>(threads, std::move(cpus));
+    }
+}
+
+void PipelineRegistry::addModel(const std::string& name, Model* model) {
+    mModels[name] = model;
+}
+
+const Pipeline* PipelineRegistry::find(const std::string& name) const {
+    auto it = mPipelines.find(name);
+    return it == mPipelines.end() ? nullptr : &it->second;
+}
+
+std::vector<std::string> PipelineRegistry::names() const {
+    std::vector<std::string> names;
+    for (const auto& pipeline : mPipelines) {
+        names.push_back(pipeline.first);
+    }
+    return names;
+}
+
+bool PipelineRegistry::load(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    std::unique_ptr<Pipeline> current;
+    bool haveOutput = false;
+    auto fail = [&](const std::string& message) {
+        error = path + ":" + std::to_string(lineNumber) + ": " + message;
+        return false;
+    };
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::vector<std::string> tokens;
+        for (std::string token; words >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+        const std::string& keyword = tokens[0];
+
+        if (keyword == "model") {
+            if (current) {
+                return fail("models must be declared outside pipelines");
+            }
+            if (tokens.size() != 3) {
+                return fail("expected: model <name> <backend spec>");
+            }
+            if (mModels.count(tokens[1])) {
+                return fail("model " + tokens[1] + " already defined");
+            }
+            auto model = createModel(tokens[2]);
+            if (!model) {
+                return fail("unknown backend " + tokens[2]);
+            }
+            if (!model->load()) {
+                return fail("failed to load model " + tokens[1]);
+            }
+            mModels[tokens[1]] = model.get();
+            mOwnedModels.push_back(std::move(model));
+        } else if (keyword == "pipeline") {
+            if (current) {
+                return fail("missing end of pipeline " + current->mName);
+            }
+            if (tokens.size() != 2) {
+                return fail("expected: pipeline <name>");
+            }
+            if (mPipelines.count(tokens[1])) {
+                return fail("pipeline " + tokens[1] + " already defined");
+            }
+            current = std::make_unique<Pipeline>();
+            current->mName = tokens[1];
+            haveOutput = false;
+        } else if (!current) {
+            return fail("unexpected " + keyword + " outside a pipeline");
+        } else if (keyword == "input") {
+            int h = 0, w = 0;
+            if (tokens.size() == 3) {
+                h = atoi(tokens[1].c_str());
+                w = atoi(tokens[2].c_str());
+            }
+            if (!current->mNodes.empty() || h <= 0 || w <= 0) {
+                return fail("expected one input <height> <width> before the nodes");
+            }
+            current->mNodes.push_back({"input", PipelineOp::kINPUT, {}, {}, {}, nullptr, {h, w}});
+        } else if (keyword == "node") {
+            if (current->mNodes.empty()) {
+                return fail("input must come before the nodes");
+            }
+            if (tokens.size() < 4) {
+                return fail("expected: node <name> <op> <inputs...> [key=value...]");
+            }
+            PipelineNode node;
+            node.name = tokens[1];
+            auto op = std::find_if(
+                opTable().begin(), opTable().end(), [&](const OpInfo& info) { return tokens[2] == info.name; });
+            if (op == opTable().end()) {
+                return fail("unknown op " + tokens[2]);
+            }
+            node.op = op->op;
+            for (const auto& existing : current->mNodes) {
+                if (existing.name == tokens[1]) {
+                    return fail("node " + tokens[1] + " already defined");
+                }
+            }
+
+            std::string modelName;
+            for (size_t i = 3; i < tokens.size(); i++) {
+                const size_t eq = tokens[i].find('=');
+                if (eq == std::string::npos) {
+                    auto producer = std::find_if(current->mNodes.begin(), current->mNodes.end(),
+                        [&](const PipelineNode& n) { return n.name == tokens[i]; });
+                    if (producer == current->mNodes.end()) {
+                        return fail("node " + tokens[i] + " is not defined above");
+                    }
+                    node.inputs.push_back(static_cast<int>(producer - current->mNodes.begin()));
+                    continue;
+                }
+                const std::string key = tokens[i].substr(0, eq);
+                const std::string value = tokens[i].substr(eq + 1);
+                if (!op->required.count(key) && !op->optional.count(key)) {
+                    return fail(std::string(op->name) + " has no parameter " + key);
+                }
+                if (key == "model") {
+                    modelName = value;
+                    continue;
+                }
+                char* end = nullptr;
+                node.params[key] = strtof(value.c_str(), &end);
+                if (value.empty() || *end != '\0') {
+                    return fail("bad value for " + key);
+                }
+            }
+            for (const auto& key : op->required) {
+                if (key != "model" && !node.params.count(key)) {
+                    return fail(std::string(op->name) + " requires " + key);
+                }
+            }
+            const int inputs = static_cast<int>(node.inputs.size());
+            if (inputs < op->minInputs || inputs > op->maxInputs) {
+                return fail(std::string(op->name) + " takes "
+                    + (op->maxInputs == 1 ? "one input" : "at least " + std::to_string(op->minInputs) + " inputs"));
+            }
+
+            // Shapes are static, so every mismatch is reported here rather than per request
+            const std::vector<int>& in = current->mNodes[node.inputs[0]].shape;
+            switch (node.op) {
+            case PipelineOp::kCROP: {
+                const int x = static_cast<int>(node.params["x"]);
+                const int y = static_cast<int>(node.params["y"]);
+                const int w = static_cast<int>(node.params["w"]);
+                const int h = static_cast<int>(node.params["h"]);
+                if (in.size() != 2 || x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > in[1] || y + h > in[0]) {
+                    return fail("crop window does not fit input " + shapeString(in));
+                }
+                node.shape = {h, w};
+                break;
+            }
+            case PipelineOp::kRESIZE: {
+                const int h = static_cast<int>(node.params["h"]);
+                const int w = static_cast<int>(node.params["w"]);
+                if (in.size() != 2 || h <= 0 || w <= 0) {
+                    return fail("resize needs a 2-D input and a positive size");
+                }
+                node.shape = {h, w};
+                break;
+            }
+            case PipelineOp::kNORMALIZE:
+                node.params.emplace("min", 0.0F);
+                node.params.emplace("max", 255.0F);
+                node.shape = in;
+                break;
+            case PipelineOp::kMODEL: {
+                auto model = mModels.find(modelName);
+                if (model == mModels.end()) {
+                    return fail("unknown model " + modelName);
+                }
+                node.model = model->second;
+                if (elements(in) != static_cast<size_t>(node.model->inputSize())) {
+                    return fail("model " + modelName + " takes " + std::to_string(node.model->inputSize())
+                        + " pixels, input is " + shapeString(in));
+                }
+                node.shape = {node.model->classCount()};
+                break;
+            }
+            case PipelineOp::kARGMAX:
+                if (in.size() != 1) {
+                    return fail("argmax needs a 1-D input, got " + shapeString(in));
+                }
+                node.shape = {1};
+                break;
+            case PipelineOp::kCONCAT: {
+                size_t total = 0;
+                for (int input : node.inputs) {
+                    total += elements(current->mNodes[input].shape);
+                }
+                node.shape = {static_cast<int>(total)};
+                break;
+            }
+            case PipelineOp::kINPUT:
+                break;
+            }
+
+            const int index = static_cast<int>(current->mNodes.size());
+            for (int input : node.inputs) {
+                auto& consumers = current->mNodes[input].consumers;
+                if (std::find(consumers.begin(), consumers.end(), index) == consumers.end()) {
+                    consumers.push_back(index);
+                }
+            }
+            current->mNodes.push_back(std::move(node));
+        } else if (keyword == "output") {
+            auto it = std::find_if(current->mNodes.begin(), current->mNodes.end(),
+                [&](const PipelineNode& n) { return tokens.size() == 2 && n.name == tokens[1]; });
+            if (it == current->mNodes.end()) {
+                return fail("expected: output <defined node>");
+            }
+            current->mOutput = static_cast<int>(it - current->mNodes.begin());
+            haveOutput = true;
+        } else if (keyword == "end") {
+            if (current->mNodes.empty() || !haveOutput) {
+                return fail("pipeline " + current->mName + " needs an input and an output");
+            }
+            const std::string name = current->mName;
+            mPipelines.emplace(name, std::move(*current));
+            current.reset();
+        } else {
+            return fail("unknown keyword " + keyword);
+        }
+    }
+    if (current) {
+        return fail("missing end of pipeline " + current->mName);
+    }
+    return true;
+}
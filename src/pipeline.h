@@ -0,0 +1,134 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "model.h"
+#include "thread_pool.h"
+
+//!
+//! Server-side pipelines: a DAG of models and CPU transforms run on one request, with the intermediate tensors
+//! kept in memory. Pipelines are declared in a text file:
+//!
+//!   # Reads a two digit number from a 28x56 image
+//!   model mnist cpu
+//!
+//!   pipeline two_digits
+//!   input 28 56
+//!   node left   crop    input  x=0 y=0 w=28 h=28
+//!   node right  crop    input  x=28 y=0 w=28 h=28
+//!   node lprob  model   left   model=mnist
+//!   node rprob  model   right  model=mnist
+//!   node ldigit argmax  lprob
+//!   node rdigit argmax  rprob
+//!   node digits concat  ldigit rdigit
+//!   output digits
+//!   end
+//!
+//! "model <name> <backend spec>" loads a model (see createModel). A node is "node <name> <op> <inputs...>
+//! [key=value...]" and may only use nodes declared above it, which keeps the graph acyclic. The image
+//! tensor is called "input". Ops:
+//!
+//!   crop      x y w h        [H,W] -> [h,w]
+//!   resize    h w            [H,W] -> [h,w], bilinear
+//!   normalize min max        stretch values linearly to [min, max] (defaults 0 and 255)
+//!   model     model          [H,W] -> [classes] probabilities; H*W must match the model input
+//!   argmax                   [n] -> [1]
+//!   concat                   any number of inputs -> [sum of sizes]
+//!
+//! Nodes whose inputs are ready run concurrently on a thread pool.
+//!
+
+struct Tensor {
+    std::vector<int> shape;
+    std::vector<float> data;
+};
+
+enum class PipelineOp {
+    kINPUT,
+    kCROP,
+    kRESIZE,
+    kNORMALIZE,
+    kMODEL,
+    kARGMAX,
+    kCONCAT,
+};
+
+struct PipelineNode {
+    std::string name;
+    PipelineOp op;
+    std::vector<int> inputs;    //!< Indices of producer nodes.
+    std::vector<int> consumers; //!< Indices of nodes that read this one.
+    std::map<std::string, float> params;
+    Model* model{nullptr};
+    std::vector<int> shape; //!< Output shape, checked when the pipeline is loaded.
+};
+
+class Pipeline {
+public:
+    const std::string& name() const {
+        return mName;
+    }
+
+    int inputH() const {
+        return mNodes[0].shape[0];
+    }
+
+    int inputW() const {
+        return mNodes[0].shape[1];
+    }
+
+    //!
+    //! \brief Runs the pipeline on an 8-bit image of inputH() x inputW() pixels and returns the output tensor.
+    //!        Independent nodes run concurrently on pool; without a pool the nodes run in declaration order on
+    //!        the calling thread.
+    //!
+    Tensor run(const uint8_t* image, ThreadPool* pool) const;
+
+private:
+    friend class PipelineRegistry;
+    struct RunState;
+
+    void execute(int node, std::vector<Tensor>& values) const;
+    void finished(const std::shared_ptr<RunState>& state, int node, ThreadPool& pool) const;
+
+    std::string mName;
+    std::vector<PipelineNode> mNodes; //!< mNodes[0] is the input; the rest are in declaration (topological) order.
+    int mOutput{0};
+};
+
+//!
+//! \brief The models and pipelines declared in a pipeline file, and the pool that runs them.
+//!
+class PipelineRegistry {
+public:
+    //!
+    //! \param threads Workers for running independent nodes concurrently; 0 runs pipelines sequentially.
+    //!
+    explicit PipelineRegistry(int threads, std::vector<int> cpus = {});
+
+    //!
+    //! \brief Makes an already loaded model available to pipelines under name.
+    //!
+    void addModel(const std::string& name, Model* model);
+
+    //!
+    //! \brief Loads a pipeline file. On failure error describes the first problem, with its line number.
+    //!
+    bool load(const std::string& path, std::string& error);
+
+    const Pipeline* find(const std::string& name) const;
+
+    Tensor run(const Pipeline& pipeline, const uint8_t* image) const {
+        return pipeline.run(image, mPool.get());
+    }
+
+    std::vector<std::string> names() const;
+
+private:
+    std::map<std::string, Model*> mModels;
+    std::vector<std::unique_ptr<Model>> mOwnedModels;
+    std::map<std::string, Pipeline> mPipelines;
+    std::unique_ptr<ThreadPool> mPool;
+};
@@ -0,0 +1,158 @@
+#include "plan_cache.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kPlanMagic[8] = {'T', 'R', 'T', 'P', 'L', 'A', 'N', '1'};
+const size_t kAlignment = 64;
+
+struct PlanHeader {
+    char magic[8];
+    uint64_t keyLength;
+    uint64_t payloadOffset;
+    uint64_t payloadSize;
+};
+
+size_t alignUp(size_t value) {
+    return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+//! Holds an exclusive flock until destroyed.
+class FileLock {
+public:
+    explicit FileLock(const std::string& path)
+        : mFd(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644))
+    {
+        if (mFd >= 0) {
+            while (flock(mFd, LOCK_EX) != 0 && errno == EINTR) {
+            }
+        }
+    }
+    ~FileLock() {
+        if (mFd >= 0) {
+            ::close(mFd); // releases the lock
+        }
+    }
+
+private:
+    int mFd;
+};
+
+} // namespace
+
+PlanCache::~PlanCache() {
+    if (mMapping) {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+std::unique_ptr<PlanCache> PlanCache::map(const std::string& path, const std::string& key) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(PlanHeader)) {
+        ::close(fd);
+        return nullptr;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    std::unique_ptr<PlanCache> cache(new PlanCache());
+    cache->mMapping = mapping;
+    cache->mMappingSize = size;
+
+    PlanHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    const char* bytes = static_cast<const char*>(mapping);
+    if (memcmp(header.magic, kPlanMagic, sizeof(kPlanMagic)) != 0 || header.keyLength != key.size()
+        || sizeof(PlanHeader) + header.keyLength > size || header.payloadOffset > size
+        || header.payloadSize > size - header.payloadOffset
+        || memcmp(bytes + sizeof(PlanHeader), key.data(), key.size()) != 0) {
+        return nullptr;
+    }
+    cache->mPayloadOffset = header.payloadOffset;
+    cache->mPayloadSize = header.payloadSize;
+    return cache;
+}
+
+std::unique_ptr<PlanCache> PlanCache::open(
+    const std::string& path, const std::string& key, const std::function<bool(std::string& payload)>& build) {
+    if (auto cache = map(path, key)) {
+        return cache;
+    }
+
+    FileLock lock(path + ".lock");
+    // Another process may have built it while we waited for the lock
+    if (auto cache = map(path, key)) {
+        return cache;
+    }
+    std::string payload;
+    if (!build(payload)) {
+        return nullptr;
+    }
+
+    PlanHeader header{};
+    memcpy(header.magic, kPlanMagic, sizeof(kPlanMagic));
+    header.keyLength = key.size();
+    header.payloadOffset = alignUp(sizeof(PlanHeader) + key.size());
+    header.payloadSize = payload.size();
+    std::string prefix(header.payloadOffset, '\0');
+    memcpy(&prefix[0], &header, sizeof(header));
+    memcpy(&prefix[sizeof(header)], key.data(), key.size());
+
+    const std::string temporary = path + ".tmp." + std::to_string(getpid());
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not create " << temporary << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    const bool written = writeAll(fd, prefix.data(), prefix.size()) && writeAll(fd, payload.data(), payload.size());
+    ::close(fd);
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not write " << path << ": " << strerror(errno) << std::endl;
+        unlink(temporary.c_str());
+        return nullptr;
+    }
+    auto cache = map(path, key);
+    if (cache) {
+        cache->mBuilt = true;
+    }
+    return cache;
+}
+
+std::string planCacheKey(const std::string& tag, const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return tag + ":" + path;
+    }
+    return tag + ":" + path + ":" + std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+}
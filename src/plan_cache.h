@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+//!
+//! \brief A prepared model (serialized engine or packed weights) kept in a file and mapped read-only, so that
+//!        every process serving the model shares one copy through the page cache.
+//!
+//! The file is a 64-byte header, the key, and the payload at the next 64-byte boundary:
+//!
+//!   char     magic[8] = "TRTPLAN1"
+//!   uint64   keyLength
+//!   uint64   payloadOffset
+//!   uint64   payloadSize
+//!   padding to 64 bytes
+//!
+//! The key identifies what the payload was built from (e.g. the source file's path, size and mtime); a cache
+//! with a different key is rebuilt.
+//!
+class PlanCache {
+public:
+    ~PlanCache();
+
+    PlanCache(const PlanCache&) = delete;
+    PlanCache& operator=(const PlanCache&) = delete;
+
+    //!
+    //! \brief Maps the cache at path, first building it with build if it is missing or its key differs.
+    //!
+    //! Processes opening the same cache at the same time serialize on an flock of "<path>.lock", so the plan
+    //! is built once. It is written under a temporary name and renamed into place, so readers never see a
+    //! partial file. Returns nullptr if build fails or the file cannot be written or mapped.
+    //!
+    static std::unique_ptr<PlanCache> open(
+        const std::string& path, const std::string& key, const std::function<bool(std::string& payload)>& build);
+
+    const char* data() const {
+        return static_cast<const char*>(mMapping) + mPayloadOffset;
+    }
+
+    size_t size() const {
+        return mPayloadSize;
+    }
+
+    //!
+    //! \brief True if open() built the payload rather than finding it in the cache.
+    //!
+    bool built() const {
+        return mBuilt;
+    }
+
+private:
+    PlanCache() = default;
+
+    static std::unique_ptr<PlanCache> map(const std::string& path, const std::string& key);
+
+    void* mMapping{nullptr};
+    size_t mMappingSize{0};
+    size_t mPayloadOffset{0};
+    size_t mPayloadSize{0};
+    bool mBuilt{false};
+};
+
+//!
+//! \brief Cache key for a payload built from the file at path: "<tag>:<path>:<size>:<mtime>".
+//!
+std::string planCacheKey(const std::string& tag, const std::string& path);
@@ -0,0 +1,340 @@
+//!
+//! Replays a traffic capture (see capture.h) against a running server and reports latency and result mismatches.
+//!
+//!   tensorrt_cpp_replay <capture file> [--host 127.0.0.1] [--port 18080] [--path <url path>]
+//!                       [--speed <factor> | --max] [--connections <n>] [--loop <n>]
+//!
+//! Each request is sent to its captured target with its captured Content-Type and Accept headers; --path replaces
+//! the path but keeps the captured query string. By default requests are sent at their captured arrival times. --speed 2 replays twice as fast, --max sends
+//! back to back on every connection. In timed modes latency is measured from the scheduled send time, so a
+//! server (or replayer) that falls behind shows up as latency instead of silently lowering the offered rate.
+//!
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "capture.h"
+#include "timing.h"
+
+struct ReplayParams {
+    std::string capturePath;
+    std::string host{"127.0.0.1"};
+    int port{18080};
+    std::string path;    //!< Replaces the captured path if set.
+    double speed{1.0};   //!< Time scale applied to captured arrival times; <= 0 means as fast as possible.
+    int connections{16}; //!< Keep-alive connections, each driven by its own thread.
+    int loops{1};        //!< Number of passes over the capture.
+};
+
+//!
+//! \brief Minimal blocking HTTP/1.1 client over one keep-alive connection.
+//!
+class HttpConnection {
+public:
+    HttpConnection(const std::string& host, int port) : mHost(host), mPort(port) {}
+
+    ~HttpConnection() {
+        disconnect();
+    }
+
+    //!
+    //! \brief Sends one POST and reads the response. Reconnects once if the server closed the connection.
+    //!
+    bool post(std::string_view target, std::string_view contentType, std::string_view accept, std::string_view body,
+        int& status, std::string& response) {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (mFd < 0 && !connect()) {
+                return false;
+            }
+            if (sendRequest(target, contentType, accept, body) && readResponse(status, response)) {
+                return true;
+            }
+            disconnect();
+        }
+        return false;
+    }
+
+private:
+    bool connect() {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(mHost.c_str(), std::to_string(mPort).c_str(), &hints, &result) != 0) {
+            return false;
+        }
+        for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+            mFd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (mFd < 0) {
+                continue;
+            }
+            if (::connect(mFd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                int one = 1;
+                setsockopt(mFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                break;
+            }
+            ::close(mFd);
+            mFd = -1;
+        }
+        freeaddrinfo(result);
+        return mFd >= 0;
+    }
+
+    void disconnect() {
+        if (mFd >= 0) {
+            ::close(mFd);
+            mFd = -1;
+        }
+        mBuffer.clear();
+    }
+
+    bool writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::send(mFd, data, size, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool sendRequest(std::string_view target, std::string_view contentType, std::string_view accept,
+        std::string_view body) {
+        std::string head;
+        head.reserve(256);
+        head += "POST ";
+        head += target;
+        head += " HTTP/1.1\r\nHost: " + mHost + "\r\nContent-Type: ";
+        head += contentType;
+        if (!accept.empty()) {
+            head += "\r\nAccept: ";
+            head += accept;
+        }
+        head += "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        return writeAll(head.data(), head.size()) && writeAll(body.data(), body.size());
+    }
+
+    bool fill() {
+        char chunk[16 * 1024];
+        ssize_t n = ::recv(mFd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        mBuffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    bool readResponse(int& status, std::string& response) {
+        size_t headerEnd;
+        while ((headerEnd = mBuffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        // "HTTP/1.1 200 OK"
+        if (mBuffer.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        status = std::atoi(mBuffer.c_str() + mBuffer.find(' ') + 1);
+
+        size_t contentLength = 0;
+        bool close = false;
+        std::string headers = mBuffer.substr(0, headerEnd);
+        std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+        auto pos = headers.find("\r\ncontent-length:");
+        if (pos != std::string::npos) {
+            contentLength = std::strtoull(headers.c_str() + pos + 17, nullptr, 10);
+        }
+        close = headers.find("\r\nconnection: close") != std::string::npos;
+
+        const size_t bodyStart = headerEnd + 4;
+        while (mBuffer.size() < bodyStart + contentLength) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        response.assign(mBuffer, bodyStart, contentLength);
+        mBuffer.erase(0, bodyStart + contentLength);
+        if (close) {
+            disconnect();
+        }
+        return true;
+    }
+
+    std::string mHost;
+    int mPort;
+    int mFd{-1};
+    std::string mBuffer; //!< Bytes received but not consumed yet.
+};
+
+//!
+//! \brief The record's target, with the path replaced by `path` if that is set.
+//!
+static std::string requestTarget(const CaptureRecord& record, const std::string& path) {
+    if (path.empty()) {
+        return std::string(record.target);
+    }
+    const size_t query = record.target.find('?');
+    return query == std::string_view::npos ? path : path + std::string(record.target.substr(query));
+}
+
+struct ReplayStats {
+    std::vector<int64_t> latenciesNs;
+    uint64_t errors{0};
+    uint64_t mismatches{0};
+    std::vector<size_t> mismatchSamples; //!< First few mismatching record indices, for reporting.
+};
+
+static void usage() {
+    std::cout << "Usage: tensorrt_cpp_replay <capture file> [--host <host>] [--port <port>] [--path <url path>]\n"
+                 "                           [--speed <factor> | --max] [--connections <n>] [--loop <n>]"
+              << std::endl;
+}
+
+static bool parseArgs(int argc, char* argv[], ReplayParams& params) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) {
+            params.host = argv[++i];
+        } else if (arg == "--port" && hasValue) {
+            params.port = std::stoi(argv[++i]);
+        } else if (arg == "--path" && hasValue) {
+            params.path = argv[++i];
+        } else if (arg == "--speed" && hasValue) {
+            params.speed = std::stod(argv[++i]);
+        } else if (arg == "--max") {
+            params.speed = 0;
+        } else if (arg == "--connections" && hasValue) {
+            params.connections = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--loop" && hasValue) {
+            params.loops = std::max(1, std::stoi(argv[++i]));
+        } else if (arg[0] != '-' && params.capturePath.empty()) {
+            params.capturePath = arg;
+        } else {
+            return false;
+        }
+    }
+    return !params.capturePath.empty();
+}
+
+int main(int argc, char* argv[]) {
+    ReplayParams params;
+    if (!parseArgs(argc, argv, params)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    CaptureReader reader;
+    if (!reader.open(params.capturePath)) {
+        return EXIT_FAILURE;
+    }
+    const auto& records = reader.records();
+    if (records.empty()) {
+        std::cout << "Capture contains no records" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Records are in arrival order, so the schedule runs from the first to the last arrival; a loop restarts it
+    // after the last one.
+    const int64_t firstArrivalNs = records.front().arrivalNs;
+    const int64_t captureSpanNs = records.back().arrivalNs - firstArrivalNs + 1;
+    const size_t total = records.size() * static_cast<size_t>(params.loops);
+    const bool timed = params.speed > 0;
+
+    std::cout << "Replaying " << records.size() << " records x" << params.loops << " against " << params.host << ":"
+              << params.port << " (" << (params.path.empty() ? "" : "path " + params.path + ", ")
+              << (timed ? "speed " + std::to_string(params.speed) : std::string("max rate")) << ", "
+              << params.connections << " connections)" << std::endl;
+
+    std::atomic<size_t> next{0};
+    std::mutex statsMutex;
+    ReplayStats stats;
+    stats.latenciesNs.reserve(total);
+    const auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        HttpConnection connection(params.host, params.port);
+        ReplayStats local;
+        std::string response;
+        for (size_t i = next.fetch_add(1); i < total; i = next.fetch_add(1)) {
+            const size_t r = i % records.size();
+            const auto& record = records[r];
+            auto scheduled = std::chrono::steady_clock::now();
+            if (timed) {
+                int64_t offsetNs = (record.arrivalNs - firstArrivalNs)
+                    + static_cast<int64_t>(i / records.size()) * captureSpanNs;
+                scheduled = start + std::chrono::nanoseconds(static_cast<int64_t>(offsetNs / params.speed));
+                std::this_thread::sleep_until(scheduled);
+            }
+            int status = 0;
+            const std::string target = requestTarget(record, params.path);
+            if (!connection.post(target, record.contentType, record.accept, record.body, status, response)) {
+                local.errors++;
+                continue;
+            }
+            local.latenciesNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - scheduled)
+                    .count());
+            if (status != record.status || response != record.response) {
+                local.mismatches++;
+                if (local.mismatchSamples.size() < 10) {
+                    local.mismatchSamples.push_back(r);
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.latenciesNs.insert(stats.latenciesNs.end(), local.latenciesNs.begin(), local.latenciesNs.end());
+        stats.errors += local.errors;
+        stats.mismatches += local.mismatches;
+        stats.mismatchSamples.insert(
+            stats.mismatchSamples.end(), local.mismatchSamples.begin(), local.mismatchSamples.end());
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < params.connections; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto& lat = stats.latenciesNs;
+    std::sort(lat.begin(), lat.end());
+    auto ms = [](int64_t ns) { return ns / 1e6; };
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Completed: " << lat.size() << "/" << total << " in " << elapsed << " s ("
+              << lat.size() / elapsed << " req/s)" << std::endl;
+    std::cout << "Errors:    " << stats.errors << std::endl;
+    std::cout << "Mismatch:  " << stats.mismatches;
+    if (!stats.mismatchSamples.empty()) {
+        std::sort(stats.mismatchSamples.begin(), stats.mismatchSamples.end());
+        std::cout << " (records";
+        for (size_t i = 0; i < std::min<size_t>(stats.mismatchSamples.size(), 10); i++) {
+            std::cout << " " << stats.mismatchSamples[i];
+        }
+        std::cout << ")";
+    }
+    std::cout << std::endl;
+    if (!lat.empty()) {
+        std::cout << "Latency ms: min " << ms(lat.front()) << "  p50 " << ms(percentile(lat, 50)) << "  p90 "
+                  << ms(percentile(lat, 90)) << "  p99 " << ms(percentile(lat, 99)) << "  p99.9 "
+                  << ms(percentile(lat, 99.9)) << "  max " << ms(lat.back()) << std::endl;
+    }
+    return stats.errors == 0 && stats.mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,95 +1,398 @@
 #include "crow.h"
 #include <fstream>
 #include <sstream>
-#include  "mnist.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include "model.h"
+#include "capture.h"
+#include "handlers.h"
+#include "service.h"
+#include "metrics.h"
+#include "model_repository.h"
+#include "pipeline.h"
+#include "supervisor.h"
+#include "tuning.h"
+#include "worker_metrics.h"
 
 
-inline std::unique_ptr<std::vector<uint8_t>> parsePGMData(const std::string& pgm) {
-    std::string magic, w, h, max;
-    auto istrream = std::istringstream(pgm);
-    istrream >> magic >> w >> h >> max;
-    istrream.seekg(1, istrream.cur);
-    auto data = std::make_unique<std::vector<uint8_t>>(std::stoi(w) * std::stoi(h));
+struct ServerOptions {
+    std::string backend{kDefaultBackend};
+    std::string capturePath;
+    std::string pipelinePath;
+    int ioThreads{0}; //!< crow worker threads; 0 keeps crow's default.
+    int preprocessThreads{0};
+    int engineThreads{0};
+    int pipelineThreads{0};
+    TunedConfig tuned; //!< Batching and instance settings, usually from a tensorrt_cpp_autotune file.
+    std::vector<std::pair<std::string, std::string>> models; //!< Lazily loaded models, name and backend spec.
+    MemoryBudget memoryBudget;
+    PinConfig pin;
+    PinConfig ioCpus, preprocessCpus, engineCpus; //!< Explicit per-pool CPU lists, override pin.
+    int workers{1}; //!< Worker processes sharing the port; more than 1 runs a supervisor.
+    std::string planCachePath; //!< File the backend's engine or weights are shared through, see PlanCache.
+};
 
-    istrream.read(reinterpret_cast<char*>(data->data()), std::stoi(w) * std::stoi(h));
-    return data;
-}
-
-crow::response handleUpload(MnistApi mnistApi, const crow::request& req) {
-    crow::multipart::message file_message(req);
-    for (const auto& part : file_message.part_map) {
-        const auto& part_name = part.first;
-        const auto& part_value = part.second;
-        CROW_LOG_DEBUG << "Part: " << part_name;
-        if ("file" == part_name) {
-            // Extract the file name
-            auto headers_it = part_value.headers.find("Content-Disposition");
-            if (headers_it == part_value.headers.end()) {
-                CROW_LOG_ERROR << "No Content-Disposition found";
-                return crow::response(400);
+static bool parseArgs(int argc, char *argv[], ServerOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--capture") {
+            options.capturePath = value;
+        } else if (arg == "--backend") {
+            options.backend = value;
+        } else if (arg == "--config") {
+            // Applied where it appears, so later options override the file
+            std::string error;
+            if (!readTunedConfig(value, options.tuned, error)) {
+                std::cout << error << std::endl;
+                return false;
             }
-            auto params_it = headers_it->second.params.find("filename");
-            if (params_it == headers_it->second.params.end()) {
-                CROW_LOG_ERROR << "Part with name \"filename\" should have a file";
-                return crow::response(400);
+            if (options.tuned.ioThreads > 0) {
+                options.ioThreads = options.tuned.ioThreads;
             }
-            const std::string outfile_name = params_it->second;
-
-            for (const auto& part_header : part_value.headers) {
-                const auto& part_header_name = part_header.first;
-                const auto& part_header_val = part_header.second;
-                CROW_LOG_DEBUG << "Header: " << part_header_name << '=' << part_header_val.value;
-                for (const auto& param : part_header_val.params) {
-                    const auto& param_key = param.first;
-                    const auto& param_val = param.second;
-                    CROW_LOG_DEBUG << " Param: " << param_key << ',' << param_val;
-                }
+        } else if (arg == "--max-batch") {
+            options.tuned.maxBatch = std::max(1, std::stoi(value));
+        } else if (arg == "--batch-delay-us") {
+            options.tuned.batchDelayUs = std::max(0, std::stoi(value));
+        } else if (arg == "--instances") {
+            options.tuned.instances = std::max(1, std::stoi(value));
+        } else if (arg == "--model") {
+            const size_t eq = value.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                return false;
             }
-
-            // Create a new file with the extracted file name and write file contents to it
-            /* Test: Save to local file
-            std::ofstream out_file(outfile_name);
-            if (!out_file) {
-                CROW_LOG_ERROR << " Write to file failed\n";
-                continue;
+            options.models.emplace_back(value.substr(0, eq), value.substr(eq + 1));
+        } else if (arg == "--host-memory-mb") {
+            options.memoryBudget.hostBytes = std::stoull(value) << 20;
+        } else if (arg == "--device-memory-mb") {
+            options.memoryBudget.deviceBytes = std::stoull(value) << 20;
+        } else if (arg == "--workers") {
+            options.workers = std::max(1, std::stoi(value));
+        } else if (arg == "--plan-cache") {
+            options.planCachePath = value;
+        } else if (arg == "--pipelines") {
+            options.pipelinePath = value;
+        } else if (arg == "--pipeline-threads") {
+            options.pipelineThreads = std::stoi(value);
+        } else if (arg == "--io-threads") {
+            options.ioThreads = std::stoi(value);
+        } else if (arg == "--preprocess-threads") {
+            options.preprocessThreads = std::stoi(value);
+        } else if (arg == "--engine-threads") {
+            options.engineThreads = std::stoi(value);
+        } else if (arg == "--pin") {
+            if (!parsePinConfig(value, options.pin)) {
+                return false;
+            }
+        } else if (arg == "--io-cpus" || arg == "--preprocess-cpus" || arg == "--engine-cpus") {
+            PinConfig& cpus = arg == "--io-cpus" ? options.ioCpus
+                : arg == "--preprocess-cpus"     ? options.preprocessCpus
+                                                 : options.engineCpus;
+            if (!parsePinConfig(value, cpus) || cpus.policy != PinPolicy::kLIST) {
+                return false;
             }
-            out_file << part_value.body;
-            out_file.close();
-            CROW_LOG_INFO << " Contents written to " << outfile_name << '\n';
-            */
-            auto data = parsePGMData(part_value.body);
-            auto result = mnistApi.infer(reinterpret_cast<char*>(data->data()));
-            CROW_LOG_DEBUG << " Inference reuslt: " << result << '\n';
-            //return crow::response(200);
-            return crow::json::wvalue({
-                {"Result", result}
-            });
-
         } else {
-            CROW_LOG_DEBUG << " Value: " << part_value.body << '\n';
+            return false;
+        }
+    }
+    // With batching the engine threads are the batcher's, one per model instance
+    if (options.engineThreads > 0 && (options.tuned.instances > 1 || options.tuned.maxBatch > 1)) {
+        std::cout << "--engine-threads cannot be combined with batching (--max-batch, --instances or --config): "
+                  << "there is one engine thread per instance" << std::endl;
+        return false;
+    }
+    // Worker processes split explicit CPU lists between them, so each needs at least one CPU of every list
+    for (const auto& list : {std::make_pair("--io-cpus", &options.ioCpus),
+             std::make_pair("--preprocess-cpus", &options.preprocessCpus),
+             std::make_pair("--engine-cpus", &options.engineCpus)}) {
+        const size_t cpus = list.second->cpus.size();
+        if (list.second->policy == PinPolicy::kLIST && cpus < static_cast<size_t>(options.workers)) {
+            std::cout << list.first << " lists " << cpus << " CPUs, fewer than the " << options.workers
+                      << " workers that split it" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//!
+//! \brief The slice of an explicit CPU list that worker workerIndex of workers uses: the list is cut into
+//!        contiguous slices, the first ones a CPU longer when it does not divide evenly.
+//!
+static std::vector<int> workerShare(const std::vector<int>& cpus, int workerIndex, int workers) {
+    const size_t base = cpus.size() / workers;
+    const size_t extra = cpus.size() % workers;
+    const size_t begin = workerIndex * base + std::min<size_t>(workerIndex, extra);
+    const size_t end = begin + base + (static_cast<size_t>(workerIndex) < extra ? 1 : 0);
+    return std::vector<int>(cpus.begin() + begin, cpus.begin() + end);
+}
+
+//!
+//! \brief Pins each crow worker to its own CPU the first time it handles a request. crow does not expose its
+//!        threads, so this is done lazily from the handler.
+//!
+class IoThreadPinner {
+public:
+    explicit IoThreadPinner(std::vector<int> cpus) : mCpus(std::move(cpus)) {}
+
+    void pinCurrentThread() {
+        thread_local bool pinned = false;
+        if (pinned || mCpus.empty()) {
+            return;
+        }
+        pinned = true;
+        int cpu = mCpus[mNext.fetch_add(1) % mCpus.size()];
+        if (!::pinCurrentThread(cpu)) {
+            CROW_LOG_WARNING << "Could not pin HTTP thread to CPU " << cpu;
         }
     }
-    return crow::response(200);
+
+private:
+    std::vector<int> mCpus;
+    std::atomic<size_t> mNext{0};
+};
+
+//!
+//! \brief Adds plan_cache=path to a cpu or tensorrt backend spec that does not have one; other specs are returned
+//!        unchanged.
+//!
+static std::string withPlanCache(const std::string& spec, const std::string& path) {
+    std::string backend;
+    std::map<std::string, std::string> backendOptions;
+    if (!parseModelSpec(spec, backend, backendOptions) || (backend != "cpu" && backend != "tensorrt")
+        || backendOptions.count("plan_cache")) {
+        return spec;
+    }
+    return spec + (spec.find(':') == std::string::npos ? ":" : ",") + "plan_cache=" + path;
 }
 
-int main() {
+//!
+//! \brief Serves requests on port 18080 until crow is stopped. With several worker processes this runs in each
+//!        of them; shared then collects their metrics.
+//!
+static int runServer(const ServerOptions& options, int workerIndex, WorkerMetrics* shared) {
     crow::SimpleApp app;
-    MnistApi mnistApi;
-    if (!mnistApi.load()) {
-        CROW_LOG_DEBUG << " Failed to load model " << '\n';
+    std::vector<std::unique_ptr<Model>> models;
+    std::vector<Model*> instances;
+    for (int i = 0; i < options.tuned.instances; i++) {
+        auto model = createModel(options.backend);
+        if (!model) {
+            CROW_LOG_ERROR << "Unknown backend " << options.backend;
+            return 1;
+        }
+        if (!model->load()) {
+            CROW_LOG_DEBUG << " Failed to load model " << '\n';
+        };
+        instances.push_back(model.get());
+        models.push_back(std::move(model));
+    }
+    Model* model = models[0].get();
+
+    // CPUs are handed out in pool order: HTTP threads first, then preprocessing, then the engine threads.
+    // Worker processes split the machine between them, each starting past the CPUs of the ones before it, and
+    // explicit lists are cut into one slice per worker.
+    const int hardwareThreads = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+    const int ioThreads = options.ioThreads > 0 ? options.ioThreads : std::max(1, hardwareThreads / options.workers);
+    CorePlanner planner(CpuTopology::detect(), options.pin);
+    const bool batching = options.tuned.instances > 1 || options.tuned.maxBatch > 1;
+    const int engineThreads = batching ? options.tuned.instances : options.engineThreads;
+    planner.take(workerIndex * (ioThreads + options.preprocessThreads + engineThreads + options.pipelineThreads));
+    auto plan = [&planner, &options, workerIndex](const PinConfig& explicitCpus, int threads) {
+        return explicitCpus.policy == PinPolicy::kLIST ? workerShare(explicitCpus.cpus, workerIndex, options.workers)
+                                                       : planner.take(threads);
     };
+    std::vector<int> ioCpus = plan(options.ioCpus, ioThreads);
+    ServiceConfig serviceConfig;
+    serviceConfig.preprocessThreads = options.preprocessThreads;
+    serviceConfig.preprocessCpus = plan(options.preprocessCpus, options.preprocessThreads);
+    // With batching the engine threads are the batcher's, one per model instance
+    serviceConfig.engineThreads = engineThreads;
+    serviceConfig.engineCpus = plan(options.engineCpus, engineThreads);
+    serviceConfig.maxBatch = options.tuned.maxBatch;
+    serviceConfig.batchDelayUs = options.tuned.batchDelayUs;
+    InferenceService service(instances, serviceConfig);
+    IoThreadPinner ioPinner(ioCpus);
+
+    // Pipelines can use the server's own model as "default" besides the models their file declares.
+    PipelineRegistry pipelines(options.pipelineThreads, planner.take(options.pipelineThreads));
+    pipelines.addModel("default", model);
+    if (!options.pipelinePath.empty()) {
+        std::string error;
+        if (!pipelines.load(options.pipelinePath, error)) {
+            CROW_LOG_ERROR << error;
+            return 1;
+        }
+        for (const auto& name : pipelines.names()) {
+            CROW_LOG_INFO << "Pipeline " << name << " at /api/pipeline/" << name;
+        }
+    }
+
+    // Models served at /api/models/<name>/upload, loaded on first use and evicted when over the memory budget
+    Metrics metrics;
+    ModelRepository repository(options.memoryBudget, &metrics);
+    for (const auto& model : options.models) {
+        if (!repository.add(model.first, model.second)) {
+            CROW_LOG_ERROR << "Model " << model.first << " is defined twice";
+            return 1;
+        }
+    }
+    auto& uploads = metrics.counter("tensorrt_requests_total{route=\"upload\"}", "Requests received");
+    auto& batches = metrics.counter("tensorrt_requests_total{route=\"batch\"}", "Requests received");
+    auto& pipelineRuns = metrics.counter("tensorrt_requests_total{route=\"pipeline\"}", "Requests received");
+    auto& modelUploads = metrics.counter("tensorrt_requests_total{route=\"models\"}", "Requests received");
+
+    // Records every upload with its arrival time and response, for replay with tensorrt_cpp_replay.
+    // Each worker process records to its own file.
+    TrafficCapture capture;
+    if (!options.capturePath.empty()) {
+        const std::string capturePath = options.workers > 1
+            ? options.capturePath + "." + std::to_string(workerIndex)
+            : options.capturePath;
+        if (!capture.open(capturePath)) {
+            return 1;
+        }
+        CROW_LOG_INFO << "Capturing traffic to " << capturePath;
+    }
 
     CROW_ROUTE(app, "/api/upload")
-      .methods(crow::HTTPMethod::Post)([mnistApi](const crow::request& req) {
-        return handleUpload(mnistApi, req);
+      .methods(crow::HTTPMethod::Post)([&service, &capture, &ioPinner, &uploads](const crow::request& req) {
+        ioPinner.pinCurrentThread();
+        uploads++;
+        if (!capture.isOpen()) {
+            return handleUpload(service, req);
+        }
+        auto arrival = capture.now();
+        auto res = handleUpload(service, req);
+        capture.append(arrival, req.raw_url, req.get_header_value("Content-Type"), req.get_header_value("Accept"),
+            req.body, res.code, res.body);
+        return res;
+      });
+
+    CROW_ROUTE(app, "/api/batch")
+      .methods(crow::HTTPMethod::Post)([&service, &ioPinner, &batches](const crow::request& req) {
+        ioPinner.pinCurrentThread();
+        batches++;
+        return handleBatch(service, req);
+      });
+
+    CROW_ROUTE(app, "/api/pipeline/<string>")
+      .methods(crow::HTTPMethod::Post)(
+          [&pipelines, &ioPinner, &pipelineRuns](const crow::request& req, const std::string& name) {
+        ioPinner.pinCurrentThread();
+        pipelineRuns++;
+        return handlePipeline(pipelines, name, req);
       });
 
+    CROW_ROUTE(app, "/api/models/<string>/upload")
+      .methods(crow::HTTPMethod::Post)(
+          [&repository, &ioPinner, &modelUploads](const crow::request& req, const std::string& name) {
+        ioPinner.pinCurrentThread();
+        modelUploads++;
+        return handleModelUpload(repository, name, req);
+      });
+
+    // With worker processes, any of them answers for all from the shared snapshots, which are at most a second
+    // old. Only the publisher thread writes this worker's snapshot: a slot takes one writer at a time.
+    CROW_ROUTE(app, "/metrics")([&metrics, shared]() {
+        crow::response res(200);
+        if (shared) {
+            shared->render(res.body);
+        } else {
+            metrics.render(res.body);
+        }
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+    });
+    std::mutex publishMutex;
+    std::condition_variable publishWake;
+    bool stopPublishing = false;
+    std::thread publisher;
+    if (shared) {
+        publisher = std::thread([&]() {
+            std::unique_lock<std::mutex> lock(publishMutex);
+            do {
+                shared->publish(workerIndex, metrics);
+            } while (!publishWake.wait_for(lock, std::chrono::seconds(1), [&]() { return stopPublishing; }));
+        });
+    }
+
     // enables all log
     app.loglevel(crow::LogLevel::Debug);
 
+    // crow's threads are created by run() and inherit this mask, so they stay on the HTTP CPUs until each one
+    // is pinned to its own CPU by IoThreadPinner.
+    if (!ioCpus.empty()) {
+        restrictCurrentThread(ioCpus);
+    }
+
     app.port(18080)
-      .multithreaded()
-      .run();
+      .multithreaded();
+    if (options.ioThreads > 0 || options.workers > 1) {
+        app.concurrency(ioThreads);
+    }
+    app.run();
 
+    if (publisher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            stopPublishing = true;
+        }
+        publishWake.notify_all();
+        publisher.join();
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]) {
+    ServerOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        std::cout << "Usage: " << argv[0] << " [--backend tensorrt|cpu|sim[:options]] [--capture <file>]\n"
+                  << "       [--io-threads <n>] [--preprocess-threads <n>] [--engine-threads <n>]\n"
+                  << "       [--pin none|compact|scatter|<cpu list>] [--io-cpus <list>] [--preprocess-cpus <list>]"
+                  << " [--engine-cpus <list>]\n"
+                  << "       [--pipelines <file>] [--pipeline-threads <n>]\n"
+                  << "       [--config <tuned file>] [--max-batch <n>] [--batch-delay-us <us>] [--instances <n>]\n"
+                  << "       [--model <name>=<backend spec>]... [--host-memory-mb <n>] [--device-memory-mb <n>]\n"
+                  << "       [--workers <n>] [--plan-cache <file>]"
+                  << std::endl;
+        return 1;
+    }
+
+    if (!options.planCachePath.empty() || options.workers > 1) {
+        // Workers share the prepared engine or weights through a file in memory-backed storage when possible
+        std::string path = options.planCachePath;
+        if (path.empty()) {
+            std::string backend;
+            std::map<std::string, std::string> backendOptions;
+            parseModelSpec(options.backend, backend, backendOptions);
+            path = (access("/dev/shm", W_OK) == 0 ? "/dev/shm/" : "/tmp/") + std::string("tensorrt_cpp_") + backend
+                + ".plan";
+        }
+        options.backend = withPlanCache(options.backend, path);
+    }
+    if (!createModel(options.backend)) {
+        std::cout << "Unknown backend " << options.backend << std::endl;
+        return 1;
+    }
+    if (options.workers <= 1) {
+        return runServer(options, 0, nullptr);
+    }
+
+    // Nothing may start threads before the workers are forked
+    WorkerMetrics shared(options.workers);
+    if (!shared.ok()) {
+        std::cout << "Could not map memory for worker metrics" << std::endl;
+        return 1;
+    }
+    enableReusePort();
+    return superviseWorkers(options.workers, [&options, &shared](int index) {
+        return runServer(options, index, &shared);
+    }, &shared);
+}
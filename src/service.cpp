@@ -0,0 +1,117 @@
+#include "service.h"
+
+#include <cstring>
+#include "pgm.h"
+
+InferenceService::InferenceService(Model& model, const ServiceConfig& config)
+    : InferenceService(std::vector<Model*>{&model}, config)
+{
+}
+
+InferenceService::InferenceService(std::vector<Model*> instances, const ServiceConfig& config)
+    : mModel(*instances.at(0))
+{
+    const size_t inputSize = static_cast<size_t>(kInputH) * kInputW;
+    if (config.preprocessThreads > 0) {
+        mPreprocess = std::make_unique<ThreadPool>(config.preprocessThreads, config.preprocessCpus, inputSize);
+    }
+    if (instances.size() > 1 || config.maxBatch > 1) {
+        mBatcher = std::make_unique<DynamicBatcher>(instances, config.maxBatch, config.batchDelayUs, config.engineCpus);
+    } else if (config.engineThreads > 0) {
+        mEngine = std::make_unique<ThreadPool>(config.engineThreads, config.engineCpus);
+    }
+}
+
+int InferenceService::infer(const uint8_t* input, float* probabilities) {
+    if (mBatcher) {
+        return mBatcher->infer(input, probabilities);
+    }
+    const char* data = reinterpret_cast<const char*>(input);
+    return probabilities ? mModel.inferProbabilities(data, probabilities) : mModel.infer(data);
+}
+
+int InferenceService::decodeAndInfer(std::string_view pgm, float* probabilities) {
+    uint8_t stack[kInputH * kInputW];
+    LocalBuffer* scratch = ThreadPool::scratch();
+    uint8_t* input = scratch ? static_cast<uint8_t*>(scratch->data()) : stack;
+    if (!decodePGM(pgm, input, kInputH, kInputW)) {
+        return -1;
+    }
+    return infer(input, probabilities);
+}
+
+int InferenceService::classify(std::string_view pgm, float* probabilities) {
+    if (!mEngine) {
+        if (mPreprocess) {
+            return mPreprocess->submit([this, pgm, probabilities]() { return decodeAndInfer(pgm, probabilities); })
+                .get();
+        }
+        return decodeAndInfer(pgm, probabilities);
+    }
+
+    // Separate stages: the input is allocated by the decoding thread, i.e. on its node.
+    auto decode = [pgm]() {
+        std::vector<uint8_t> input(static_cast<size_t>(kInputH) * kInputW);
+        if (!decodePGM(pgm, input.data(), kInputH, kInputW)) {
+            input.clear();
+        }
+        return input;
+    };
+    std::vector<uint8_t> input = mPreprocess ? mPreprocess->submit(decode).get() : decode();
+    if (input.empty()) {
+        return -1;
+    }
+    return mEngine->submit([this, &input, probabilities]() { return infer(input.data(), probabilities); }).get();
+}
+
+void InferenceService::classifyBatch(const std::vector<std::string_view>& pgms, BatchResult& result) {
+    const size_t n = pgms.size();
+    const size_t inputSize = static_cast<size_t>(kInputH) * kInputW;
+    result.classes = mModel.classCount();
+    result.results.assign(n, -1);
+    result.status.assign(n, 0);
+    result.probabilities.assign(result.withProbabilities ? n * result.classes : 0, 0.0F);
+
+    std::vector<uint8_t> input(n * inputSize);
+    auto decode = [&]() {
+        for (size_t i = 0; i < n; i++) {
+            if (!decodePGM(pgms[i], input.data() + i * inputSize, kInputH, kInputW)) {
+                result.status[i] = 1;
+                memset(input.data() + i * inputSize, 255, inputSize);
+            }
+        }
+    };
+    auto infer = [&]() {
+        const char* data = reinterpret_cast<const char*>(input.data());
+        if (mBatcher) {
+            mBatcher->inferMany(input.data(), static_cast<int>(n), result.results.data(),
+                result.withProbabilities ? result.probabilities.data() : nullptr);
+        } else if (result.withProbabilities) {
+            for (size_t i = 0; i < n; i++) {
+                if (result.status[i] == 0) {
+                    result.results[i]
+                        = mModel.inferProbabilities(data + i * inputSize, result.probabilities.data() + i * result.classes);
+                }
+            }
+            return;
+        } else {
+            mModel.inferBatch(data, static_cast<int>(n), result.results.data());
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (result.status[i] != 0) {
+                result.results[i] = -1;
+            }
+        }
+    };
+
+    if (mPreprocess) {
+        mPreprocess->submit(decode).get();
+    } else {
+        decode();
+    }
+    if (mEngine) {
+        mEngine->submit(infer).get();
+    } else {
+        infer();
+    }
+}
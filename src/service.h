@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "batcher.h"
+#include "encoding.h"
+#include "model.h"
+#include "thread_pool.h"
+
+struct ServiceConfig {
+    int preprocessThreads{0};        //!< PGM decoding workers; 0 decodes on the calling (HTTP) thread.
+    int engineThreads{0};            //!< Threads driving the model; 0 runs inference on the decoding thread.
+    std::vector<int> preprocessCpus; //!< One CPU per preprocessing worker, empty for no pinning.
+    std::vector<int> engineCpus;     //!< One CPU per engine thread, empty for no pinning.
+    int maxBatch{1};                 //!< Largest batch the dynamic batcher forms from concurrent requests.
+    int64_t batchDelayUs{0};         //!< How long the batcher waits for a batch to fill up.
+};
+
+//!
+//! \brief The in-process request path: decode an uploaded PGM, then classify it.
+//!
+//! Each stage can run on its own pinned thread pool. Without an engine pool the whole request runs on the
+//! decoding worker and uses its NUMA-local scratch buffer as model input, so nothing is allocated per request.
+//!
+//! With several model instances or maxBatch > 1, concurrent requests are grouped by a DynamicBatcher that runs
+//! one thread per instance (pinned to engineCpus) in place of the engine pool.
+//!
+class InferenceService {
+public:
+    InferenceService(Model& model, const ServiceConfig& config);
+    InferenceService(std::vector<Model*> instances, const ServiceConfig& config);
+
+    //!
+    //! \brief Decodes and classifies one PGM image. Returns -1 if the image cannot be decoded. When probabilities
+    //!        is not null it receives classCount() class probabilities.
+    //!
+    int classify(std::string_view pgm, float* probabilities = nullptr);
+
+    //!
+    //! \brief Decodes and classifies several PGM images as one batch. Fills results, status and, when
+    //!        result.withProbabilities is set, probabilities. Items that cannot be decoded get status 1.
+    //!
+    void classifyBatch(const std::vector<std::string_view>& pgms, BatchResult& result);
+
+    int classCount() const {
+        return mModel.classCount();
+    }
+
+    static const int kInputH = 28;
+    static const int kInputW = 28;
+
+private:
+    int decodeAndInfer(std::string_view pgm, float* probabilities);
+
+    int infer(const uint8_t* input, float* probabilities);
+
+    Model& mModel;
+    std::unique_ptr<ThreadPool> mPreprocess;
+    std::unique_ptr<ThreadPool> mEngine;
+    std::unique_ptr<DynamicBatcher> mBatcher;
+};
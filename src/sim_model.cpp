@@ -0,0 +1,101 @@
+#include "sim_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+SimulatedModel::SimulatedModel(const SimulatedModelParams& params)
+    : mParams(params)
+{
+}
+
+bool SimulatedModel::parseParams(const std::map<std::string, std::string>& options, SimulatedModelParams& params) {
+    for (const auto& option : options) {
+        const auto& key = option.first;
+        const auto& value = option.second;
+        try {
+            if (key == "latency_us") {
+                params.latencyUs = std::stoll(value);
+            } else if (key == "per_item_us") {
+                params.perItemUs = std::stoll(value);
+            } else if (key == "load_ms") {
+                params.loadMs = std::stoll(value);
+            } else if (key == "fail_load") {
+                params.failLoad = value != "0" && value != "false";
+            } else if (key == "spin") {
+                params.spin = value != "0" && value != "false";
+            } else if (key == "streams") {
+                params.streams = std::max(1, std::stoi(value));
+            } else if (key == "classes") {
+                params.classes = std::max(1, std::stoi(value));
+            } else if (key == "host_mb") {
+                params.memory.hostBytes = std::stoull(value) << 20;
+            } else if (key == "device_mb") {
+                params.memory.deviceBytes = std::stoull(value) << 20;
+            } else {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SimulatedModel::load() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(mParams.loadMs));
+    mLoaded = !mParams.failLoad;
+    return mLoaded;
+}
+
+int SimulatedModel::classify(const char *data) const {
+    // FNV-1a over the input
+    uint32_t hash = 2166136261U;
+    for (int i = 0; i < inputSize(); i++) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619U;
+    }
+    return static_cast<int>(hash % static_cast<uint32_t>(mParams.classes));
+}
+
+void SimulatedModel::wait(int64_t us) {
+    if (us <= 0) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mStreamFree.wait(lock, [this]() { return mBusy < mParams.streams; });
+        mBusy++;
+    }
+    const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    if (!mParams.spin) {
+        std::this_thread::sleep_until(until);
+    } else {
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBusy--;
+    }
+    mStreamFree.notify_one();
+}
+
+int SimulatedModel::infer(const char *data) {
+    wait(mParams.latencyUs + mParams.perItemUs);
+    return classify(data);
+}
+
+int SimulatedModel::inferProbabilities(const char *data, float *probabilities) {
+    int result = infer(data);
+    for (int i = 0; i < mParams.classes; i++) {
+        probabilities[i] = i == result ? 1.0F : 0.0F;
+    }
+    return result;
+}
+
+void SimulatedModel::inferBatch(const char *data, int count, int *results) {
+    wait(mParams.latencyUs + mParams.perItemUs * count);
+    for (int i = 0; i < count; i++) {
+        results[i] = classify(data + static_cast<size_t>(i) * inputSize());
+    }
+}
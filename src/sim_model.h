@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include "model.h"
+
+struct SimulatedModelParams {
+    int64_t latencyUs{200}; //!< Fixed cost of every infer() or inferBatch() call.
+    int64_t perItemUs{10};  //!< Additional cost per image of a batch.
+    int64_t loadMs{0};      //!< Time load() takes.
+    bool failLoad{false};   //!< Make load() fail, after loadMs.
+    bool spin{false};       //!< Burn CPU instead of sleeping, to stand in for a CPU-bound backend.
+    int streams{1};         //!< Calls the model serves at the same time; further callers wait, as on a GPU stream.
+    int classes{10};
+    ModelMemory memory;     //!< Declared footprint, reported by memoryUsage() once loaded.
+};
+
+//!
+//! \brief Stand-in backend with a configurable cost model and deterministic results.
+//!
+//! The predicted class is a hash of the input bytes, so identical inputs always give identical results and
+//! different crops of an image usually do not. Useful for exercising scheduling, batching and memory policies
+//! on machines without a GPU.
+//!
+class SimulatedModel: public Model {
+public:
+    explicit SimulatedModel(const SimulatedModelParams& params = SimulatedModelParams());
+
+    //!
+    //! \brief Builds the parameters from backend options ("latency_us", "per_item_us", "load_ms", "spin",
+    //!        "streams", "classes", "host_mb", "device_mb", "fail_load"). Returns false on an unknown option.
+    //!
+    static bool parseParams(const std::map<std::string, std::string>& options, SimulatedModelParams& params);
+
+    virtual bool load();
+    virtual int infer(const char *data);
+    virtual int inferProbabilities(const char *data, float *probabilities);
+    virtual void inferBatch(const char *data, int count, int *results);
+    virtual int classCount() const {
+        return mParams.classes;
+    }
+    virtual ModelMemory memoryUsage() const {
+        return mLoaded ? mParams.memory : ModelMemory();
+    }
+
+private:
+    int classify(const char *data) const;
+    void wait(int64_t us);
+
+    SimulatedModelParams mParams;
+    std::mutex mMutex;
+    std::condition_variable mStreamFree;
+    int mBusy{0};
+    bool mLoaded{false};
+};
@@ -0,0 +1,169 @@
+#include "supervisor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "worker_metrics.h"
+
+namespace {
+
+std::atomic<bool> gReusePort{false};
+volatile sig_atomic_t gStopSignal = 0;
+
+void onStopSignal(int signal) {
+    gStopSignal = signal;
+}
+
+struct Worker {
+    pid_t pid{-1};
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point restartAt; //!< When a dead worker is due to be started again.
+    std::chrono::milliseconds backoff{0};
+};
+
+pid_t startWorker(int index, const std::function<int(int index)>& runWorker) {
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() == 1) {
+        _exit(1); // the supervisor died before we could ask to be told
+    }
+    const int code = runWorker(index);
+    std::cout.flush();
+    _exit(code);
+}
+
+} // namespace
+
+void enableReusePort() {
+    gReusePort = true;
+}
+
+//! Interposed over libc's bind() for the whole executable; see enableReusePort().
+extern "C" int bind(int fd, const struct sockaddr* address, socklen_t length) {
+    using BindFunction = int (*)(int, const struct sockaddr*, socklen_t);
+    static BindFunction next = reinterpret_cast<BindFunction>(dlsym(RTLD_NEXT, "bind"));
+    if (!next) {
+        errno = ENOSYS;
+        return -1;
+    }
+    if (gReusePort && address && (address->sa_family == AF_INET || address->sa_family == AF_INET6)) {
+        int type = 0;
+        socklen_t typeLength = sizeof(type);
+        const int one = 1;
+        if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) == 0 && type == SOCK_STREAM) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        }
+    }
+    return next(fd, address, length);
+}
+
+int superviseWorkers(int workers, const std::function<int(int index)>& runWorker, WorkerMetrics* metrics) {
+    using Clock = std::chrono::steady_clock;
+    const auto kHealthyUptime = std::chrono::seconds(1);
+    const auto kFirstBackoff = std::chrono::milliseconds(100);
+    const auto kMaxBackoff = std::chrono::milliseconds(5000);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::vector<Worker> pool(std::max(1, workers));
+    for (size_t i = 0; i < pool.size(); i++) {
+        pool[i].pid = startWorker(static_cast<int>(i), runWorker);
+        pool[i].started = Clock::now();
+    }
+    std::cout << "Started " << pool.size() << " worker processes" << std::endl;
+
+    while (!gStopSignal) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0) {
+            auto worker = std::find_if(pool.begin(), pool.end(), [pid](const Worker& w) { return w.pid == pid; });
+            if (worker == pool.end()) {
+                continue;
+            }
+            const int index = static_cast<int>(worker - pool.begin());
+            if (WIFSIGNALED(status)) {
+                std::cout << "Worker " << index << " (pid " << pid << ") killed by signal " << WTERMSIG(status)
+                          << std::endl;
+            } else {
+                std::cout << "Worker " << index << " (pid " << pid << ") exited with " << WEXITSTATUS(status)
+                          << std::endl;
+            }
+            if (metrics) {
+                metrics->retire(index);
+            }
+            const auto now = Clock::now();
+            worker->backoff = now - worker->started < kHealthyUptime
+                ? std::min<std::chrono::milliseconds>(kMaxBackoff, std::max(kFirstBackoff, worker->backoff * 2))
+                : std::chrono::milliseconds(0);
+            worker->pid = -1;
+            worker->restartAt = now + worker->backoff;
+            continue;
+        }
+
+        const auto now = Clock::now();
+        for (size_t i = 0; i < pool.size(); i++) {
+            if (pool[i].pid < 0 && now >= pool[i].restartAt) {
+                pool[i].pid = startWorker(static_cast<int>(i), runWorker);
+                pool[i].started = now;
+                if (metrics) {
+                    metrics->recordRestart();
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    // Ask every worker to stop and give them time to finish their requests
+    for (const auto& worker : pool) {
+        if (worker.pid > 0) {
+            kill(worker.pid, SIGTERM);
+        }
+    }
+    const auto deadline = Clock::now() + std::chrono::seconds(10);
+    size_t running = std::count_if(pool.begin(), pool.end(), [](const Worker& w) { return w.pid > 0; });
+    while (running > 0) {
+        pid_t pid = waitpid(-1, nullptr, WNOHANG);
+        if (pid > 0) {
+            for (auto& worker : pool) {
+                if (worker.pid == pid) {
+                    worker.pid = -1;
+                    running--;
+                }
+            }
+            continue;
+        }
+        if (pid < 0 && errno == ECHILD) {
+            break;
+        }
+        if (Clock::now() > deadline) {
+            for (const auto& worker : pool) {
+                if (worker.pid > 0) {
+                    kill(worker.pid, SIGKILL);
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return 0;
+}
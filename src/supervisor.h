@@ -0,0 +1,23 @@
+#pragma once
+
+#include <functional>
+
+class WorkerMetrics;
+
+//!
+//! \brief Forks worker processes that each run runWorker(index), and restarts any that exits until the
+//!        supervisor receives SIGINT or SIGTERM, which it forwards to the workers before waiting for them.
+//!
+//! A worker that exits within a second of being started is restarted after a delay that doubles up to five
+//! seconds, so a worker that cannot start does not spin. Workers get SIGTERM if the supervisor dies. Nothing in
+//! the calling process may have started threads yet. Returns the supervisor's exit code.
+//!
+int superviseWorkers(int workers, const std::function<int(int index)>& runWorker, WorkerMetrics* metrics);
+
+//!
+//! \brief Makes every TCP socket this process binds from now on set SO_REUSEPORT first, so that several worker
+//!        processes can listen on the same port and the kernel spreads connections across them.
+//!
+//! crow does not expose its acceptor before binding it, so bind() is interposed for the whole executable.
+//!
+void enableReusePort();
@@ -0,0 +1,55 @@
+#include "thread_pool.h"
+
+#include <iostream>
+
+namespace {
+thread_local LocalBuffer* tScratch = nullptr;
+}
+
+ThreadPool::ThreadPool(int threads, std::vector<int> cpus, size_t scratchSize) {
+    for (int i = 0; i < threads; i++) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        mThreads.emplace_back(&ThreadPool::run, this, cpu, scratchSize);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mCondition.notify_all();
+    for (auto& t : mThreads) {
+        t.join();
+    }
+}
+
+LocalBuffer* ThreadPool::scratch() {
+    return tScratch;
+}
+
+void ThreadPool::run(int cpu, size_t scratchSize) {
+    if (cpu >= 0 && !pinCurrentThread(cpu)) {
+        std::cerr << "Could not pin worker to CPU " << cpu << std::endl;
+    }
+    LocalBuffer scratch;
+    if (scratchSize) {
+        scratch = LocalBuffer(scratchSize);
+        tScratch = &scratch;
+    }
+
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStop || !mTasks.empty(); });
+            if (mTasks.empty()) {
+                break;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+    tScratch = nullptr;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "affinity.h"
+
+//!
+//! \brief Fixed-size pool of worker threads with optional CPU pinning.
+//!
+//! Each worker pins itself before doing anything else and then allocates its scratch buffer, so the scratch
+//! memory lives on the worker's NUMA node.
+//!
+class ThreadPool {
+public:
+    //!
+    //! \param threads Number of workers.
+    //! \param cpus CPU per worker (cpus[i % cpus.size()]); empty leaves placement to the scheduler.
+    //! \param scratchSize Bytes of per-worker scratch memory, see scratch().
+    //!
+    ThreadPool(int threads, std::vector<int> cpus = {}, size_t scratchSize = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename Fn>
+    auto submit(Fn&& fn) -> std::future<decltype(fn())> {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.emplace_back([task]() { (*task)(); });
+        }
+        mCondition.notify_one();
+        return future;
+    }
+
+    int size() const {
+        return static_cast<int>(mThreads.size());
+    }
+
+    //!
+    //! \brief Scratch buffer of the calling worker, or nullptr when called from outside a pool.
+    //!
+    static LocalBuffer* scratch();
+
+private:
+    void run(int cpu, size_t scratchSize);
+
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<std::function<void()>> mTasks;
+    bool mStop{false};
+};
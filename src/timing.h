@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//!
+//! Clock and latency statistics shared by the server tools and the benchmarks.
+//!
+
+//!
+//! \brief steady_clock time in nanoseconds.
+//!
+inline int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//!
+//! \brief p-th percentile (0-100) of a sorted vector, nearest rank; 0 if empty.
+//!
+template <typename T>
+inline T percentile(const std::vector<T>& sorted, double p) {
+    if (sorted.empty()) {
+        return T{};
+    }
+    size_t idx = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
@@ -0,0 +1,79 @@
+#include "tuning.h"
+
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+bool TunedConfig::operator<(const TunedConfig& other) const {
+    return std::tie(maxBatch, batchDelayUs, instances, ioThreads)
+        < std::tie(other.maxBatch, other.batchDelayUs, other.instances, other.ioThreads);
+}
+
+std::string TunedConfig::toString() const {
+    return "max_batch=" + std::to_string(maxBatch) + " batch_delay_us=" + std::to_string(batchDelayUs)
+        + " instances=" + std::to_string(instances) + " io_threads=" + std::to_string(ioThreads);
+}
+
+bool readTunedConfig(const std::string& path, TunedConfig& config, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string entry;
+        if (!(words >> entry)) {
+            continue;
+        }
+        const size_t eq = entry.find('=');
+        const std::string key = entry.substr(0, eq);
+        int64_t value = -1;
+        if (eq != std::string::npos) {
+            char* end = nullptr;
+            value = strtoll(entry.c_str() + eq + 1, &end, 10);
+            if (end == entry.c_str() + eq + 1 || *end != '\0') {
+                value = -1;
+            }
+        }
+        const bool positive = key != "batch_delay_us" && key != "io_threads";
+        if (value < (positive ? 1 : 0)) {
+            error = path + ":" + std::to_string(lineNumber) + ": expected " + key + "=<"
+                + (positive ? "positive" : "non-negative") + " integer>";
+            return false;
+        }
+        if (key == "max_batch") {
+            config.maxBatch = static_cast<int>(value);
+        } else if (key == "batch_delay_us") {
+            config.batchDelayUs = value;
+        } else if (key == "instances") {
+            config.instances = static_cast<int>(value);
+        } else if (key == "io_threads") {
+            config.ioThreads = static_cast<int>(value);
+        } else {
+            error = path + ":" + std::to_string(lineNumber) + ": unknown key " + key;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeTunedConfig(const std::string& path, const TunedConfig& config, const std::string& comment) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::istringstream lines(comment);
+    for (std::string line; std::getline(lines, line);) {
+        file << "# " << line << "\n";
+    }
+    file << "max_batch=" << config.maxBatch << "\n"
+         << "batch_delay_us=" << config.batchDelayUs << "\n"
+         << "instances=" << config.instances << "\n"
+         << "io_threads=" << config.ioThreads << "\n";
+    return static_cast<bool>(file);
+}
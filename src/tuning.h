@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//!
+//! Batching and concurrency settings, as found by tensorrt_cpp_autotune and loaded by the server with
+//! --config. The file holds one key=value pair per line; '#' starts a comment:
+//!
+//!   max_batch=16
+//!   batch_delay_us=500
+//!   instances=2
+//!   io_threads=32
+//!
+
+struct TunedConfig {
+    int maxBatch{1};         //!< Largest batch formed from concurrent requests.
+    int64_t batchDelayUs{0}; //!< Time a batch may wait to fill up.
+    int instances{1};        //!< Model instances, each driven by its own thread.
+    int ioThreads{0};        //!< Threads handling requests (crow workers); 0 keeps the default.
+
+    bool operator<(const TunedConfig& other) const;
+    std::string toString() const;
+};
+
+//!
+//! \brief Reads a config file. Unknown keys and bad values are errors, described in error.
+//!
+bool readTunedConfig(const std::string& path, TunedConfig& config, std::string& error);
+
+//!
+//! \brief Writes config to path, preceded by comment (may span lines) as '#' lines.
+//!
+bool writeTunedConfig(const std::string& path, const TunedConfig& config, const std::string& comment);
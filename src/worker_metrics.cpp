@@ -0,0 +1,126 @@
+#include "worker_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+struct WorkerMetrics::Slot {
+    //! Number of writes started plus completed: odd while one is in progress. A write fills the copy the
+    //! previous one did not, so copies[(sequence / 2) % 2] is always the last complete one.
+    std::atomic<uint64_t> sequence;
+    struct Copy {
+        std::atomic<uint32_t> length;
+        char text[kSlotBytes];
+    } copies[2];
+};
+
+struct WorkerMetrics::Shared {
+    std::atomic<int64_t> restarts;
+    Slot slots[1]; //!< One per worker, then the retired totals; allocated past the end of the struct.
+};
+
+WorkerMetrics::WorkerMetrics(int workers)
+    : mWorkers(std::max(1, workers))
+    , mRetired(std::make_unique<Metrics>())
+{
+    mSharedBytes = sizeof(Shared) + sizeof(Slot) * mWorkers;
+    void* memory = mmap(nullptr, mSharedBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return;
+    }
+    mShared = static_cast<Shared*>(memory);
+    new (&mShared->restarts) std::atomic<int64_t>(0);
+    for (int i = 0; i <= mWorkers; i++) {
+        new (&mShared->slots[i].sequence) std::atomic<uint64_t>(0);
+        new (&mShared->slots[i].copies[0].length) std::atomic<uint32_t>(0);
+        new (&mShared->slots[i].copies[1].length) std::atomic<uint32_t>(0);
+    }
+}
+
+WorkerMetrics::~WorkerMetrics() {
+    if (mShared) {
+        munmap(mShared, mSharedBytes);
+    }
+}
+
+void WorkerMetrics::write(int slot, const std::string& text) {
+    Slot& s = mShared->slots[slot];
+    const uint64_t sequence = s.sequence.load(std::memory_order_relaxed);
+    Slot::Copy& copy = s.copies[(sequence / 2 + 1) % 2];
+    s.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(copy.text, text.data(), text.size());
+    copy.length.store(static_cast<uint32_t>(text.size()), std::memory_order_relaxed);
+    s.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool WorkerMetrics::read(int slot, std::string& text) const {
+    const Slot& s = mShared->slots[slot];
+    for (int attempt = 0; attempt < 100; attempt++) {
+        // A write in progress does not touch the last complete copy, so there is no need to wait for it; the
+        // copy is only overwritten once a second write starts, which is what the check afterwards detects.
+        const uint64_t before = s.sequence.load(std::memory_order_acquire);
+        const Slot::Copy& copy = s.copies[(before / 2) % 2];
+        const uint32_t length = std::min<uint32_t>(copy.length.load(std::memory_order_relaxed), kSlotBytes);
+        text.assign(copy.text, length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) - (before & ~uint64_t(1)) < 3) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkerMetrics::publish(int worker, const Metrics& metrics) {
+    if (!mShared || worker < 0 || worker >= mWorkers) {
+        return false;
+    }
+    std::string text;
+    metrics.render(text);
+    if (text.size() > kSlotBytes) {
+        return false;
+    }
+    write(worker, text);
+    return true;
+}
+
+void WorkerMetrics::retire(int worker) {
+    if (!mShared || worker < 0 || worker >= mWorkers) {
+        return;
+    }
+    std::string text;
+    if (read(worker, text)) {
+        mRetired->merge(text, true);
+    }
+    write(worker, "");
+    std::string retired;
+    mRetired->render(retired);
+    if (retired.size() <= kSlotBytes) {
+        write(mWorkers, retired);
+    }
+}
+
+void WorkerMetrics::recordRestart() {
+    if (mShared) {
+        mShared->restarts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void WorkerMetrics::render(std::string& out) const {
+    if (!mShared) {
+        return;
+    }
+    Metrics total;
+    std::string text;
+    for (int i = 0; i <= mWorkers; i++) {
+        if (read(i, text)) {
+            total.merge(text);
+        }
+    }
+    total.gauge("tensorrt_workers", "Worker processes serving requests") = mWorkers;
+    total.counter("tensorrt_worker_restarts_total", "Worker processes restarted after exiting")
+        = mShared->restarts.load(std::memory_order_relaxed);
+    total.render(out);
+}
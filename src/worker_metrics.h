@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "metrics.h"
+
+//!
+//! \brief Metrics of the worker processes of one server, shared through memory mapped before they are forked,
+//!        so that any worker can answer /metrics for all of them.
+//!
+//! Every worker publishes its rendered Metrics into its own slot, which keeps the last two copies: a write fills
+//! the older one and a sequence number tells readers in other processes which copy is complete, so they never
+//! wait for a writer and detect torn copies without a lock. Each slot has a single writer, the worker's
+//! publisher thread. render() sums the series of all slots. When a worker dies, even in the middle of a write,
+//! the supervisor folds the counters of its last complete copy into a slot of retired totals, so counters do
+//! not go backwards when it is restarted; its gauges are dropped.
+//!
+class WorkerMetrics {
+public:
+    //!
+    //! \brief Maps the shared slots. Must be called before the workers are forked.
+    //!
+    explicit WorkerMetrics(int workers);
+    ~WorkerMetrics();
+
+    WorkerMetrics(const WorkerMetrics&) = delete;
+    WorkerMetrics& operator=(const WorkerMetrics&) = delete;
+
+    bool ok() const {
+        return mShared != nullptr;
+    }
+
+    int workers() const {
+        return mWorkers;
+    }
+
+    //!
+    //! \brief Replaces the snapshot of a worker. Returns false if the text does not fit its slot. Only one thread
+    //!        of the worker may publish.
+    //!
+    bool publish(int worker, const Metrics& metrics);
+
+    //!
+    //! \brief Called by the supervisor after a worker exited: keeps its counters and clears its slot.
+    //!
+    void retire(int worker);
+
+    //!
+    //! \brief Counts a restart of a worker process, reported as tensorrt_worker_restarts_total.
+    //!
+    void recordRestart();
+
+    //!
+    //! \brief Appends the sum of all workers' series to out, plus tensorrt_workers and the restart counter.
+    //!
+    void render(std::string& out) const;
+
+    static const size_t kSlotBytes = 64 << 10;
+
+private:
+    struct Slot;
+    struct Shared;
+
+    bool read(int slot, std::string& text) const;
+    void write(int slot, const std::string& text);
+
+    int mWorkers;
+    Shared* mShared{nullptr};
+    size_t mSharedBytes{0};
+    std::unique_ptr<Metrics> mRetired; //!< Supervisor only: counters of workers that exited.
+};
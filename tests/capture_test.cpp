@@ -0,0 +1,91 @@
+//!
+//! TrafficCapture and CaptureReader: every field of a record survives the round trip, records come back in
+//! arrival order, and a truncated trailing record is dropped.
+//!
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include "capture.h"
+#include "test.h"
+
+namespace {
+
+std::string tempPath(const std::string& name) {
+    const char* dir = std::getenv("TMPDIR");
+    return std::string(dir ? dir : "/tmp") + "/" + name + "." + std::to_string(getpid());
+}
+
+} // namespace
+
+TEST(recordsRoundTripInArrivalOrder) {
+    const std::string path = tempPath("capture_test");
+    {
+        TrafficCapture capture;
+        CHECK(capture.open(path));
+        // Appended in completion order: the second request finished first
+        CHECK(capture.append(20, "/api/upload?probabilities=1", "multipart/form-data; boundary=a",
+            "application/msgpack", "first body", 200, "first response"));
+        CHECK(capture.append(10, "/api/upload", "multipart/form-data; boundary=b", "", "second", 400, ""));
+    }
+
+    CaptureReader reader;
+    CHECK(reader.open(path));
+    const auto& records = reader.records();
+    CHECK_EQ(records.size(), 2U);
+    if (records.size() == 2) {
+        CHECK_EQ(records[0].arrivalNs, 10);
+        CHECK_EQ(records[0].status, 400);
+        CHECK_EQ(records[0].target, "/api/upload");
+        CHECK_EQ(records[0].accept, "");
+        CHECK_EQ(records[0].body, "second");
+        CHECK_EQ(records[0].response, "");
+        CHECK_EQ(records[1].arrivalNs, 20);
+        CHECK_EQ(records[1].target, "/api/upload?probabilities=1");
+        CHECK_EQ(records[1].contentType, "multipart/form-data; boundary=a");
+        CHECK_EQ(records[1].accept, "application/msgpack");
+        CHECK_EQ(records[1].body, "first body");
+        CHECK_EQ(records[1].response, "first response");
+    }
+    std::remove(path.c_str());
+}
+
+TEST(truncatedTrailingRecordIsDropped) {
+    const std::string path = tempPath("capture_test_truncated");
+    {
+        TrafficCapture capture;
+        CHECK(capture.open(path));
+        CHECK(capture.append(1, "/api/upload", "text/plain", "", "kept", 200, "ok"));
+        CHECK(capture.append(2, "/api/upload", "text/plain", "", "cut off", 200, "ok"));
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size() - 4);
+
+    CaptureReader reader;
+    CHECK(reader.open(path));
+    CHECK_EQ(reader.records().size(), 1U);
+    if (!reader.records().empty()) {
+        CHECK_EQ(reader.records()[0].body, "kept");
+    }
+    std::remove(path.c_str());
+}
+
+TEST(rejectsOtherVersions) {
+    const std::string path = tempPath("capture_test_version");
+    CaptureFileHeader header{};
+    std::copy(kCaptureMagic, kCaptureMagic + sizeof(kCaptureMagic), header.magic);
+    header.version = kCaptureVersion - 1;
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    CaptureReader reader;
+    CHECK(!reader.open(path));
+    std::remove(path.c_str());
+}
+
+int main() {
+    return test::runAll();
+}
@@ -0,0 +1,61 @@
+//!
+//! Response encoding and softmax: JSON stays valid when a model reports non-finite probabilities, and
+//! softmaxArgmax does not overflow on large logits.
+//!
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "encoding.h"
+#include "mnist_io.h"
+#include "test.h"
+
+namespace {
+
+//!
+//! \brief std::isfinite() on the bits, which -Ofast cannot assume away.
+//!
+bool finite(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7f800000U) != 0x7f800000U;
+}
+
+} // namespace
+
+TEST(nonFiniteProbabilitiesAreNullInJSON) {
+    BatchResult result;
+    result.classes = 3;
+    result.results.push_back(1);
+    result.status.push_back(0);
+    result.withProbabilities = true;
+    result.probabilities = {std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), 0.5F};
+    std::string json;
+    encodeJSON(result, json);
+    CHECK_EQ(json, "{\"Result\":1,\"Probabilities\":[null,null,0.5]}");
+
+    std::string tensor;
+    encodeTensor({2}, {-std::numeric_limits<float>::infinity(), 2.0F}, Encoding::kJSON, tensor);
+    CHECK_EQ(tensor, "{\"Output\":[null,2],\"Shape\":[2]}");
+}
+
+TEST(softmaxOfLargeLogitsIsFinite) {
+    float values[3] = {1000.0F, 999.0F, -1000.0F};
+    CHECK_EQ(softmaxArgmax(values, 3), 0);
+    float sum = 0.0F;
+    for (float v : values) {
+        CHECK(finite(v));
+        sum += v;
+    }
+    CHECK(std::fabs(sum - 1.0F) < 1e-6F);
+    CHECK(values[0] > values[1]);
+
+    // Ties still go to the last class
+    float tied[2] = {3.0F, 3.0F};
+    CHECK_EQ(softmaxArgmax(tied, 2), 1);
+    CHECK_EQ(tied[0], 0.5F);
+}
+
+int main() {
+    return test::runAll();
+}
@@ -0,0 +1,175 @@
+//!
+//! ModelRepository: lazy loading, LRU eviction within a memory budget, leases and shared in-flight loads. The
+//! models are SimulatedModel instances created by a factory that counts them, with their footprint declared
+//! through "host_mb".
+//!
+
+#include <atomic>
+#include <thread>
+#include "model_repository.h"
+#include "sim_model.h"
+#include "test.h"
+
+namespace {
+
+const size_t kMB = size_t(1) << 20;
+
+//!
+//! \brief Repository with a host budget of budgetMb whose factory builds "sim" models and counts them.
+//!
+struct Fixture {
+    explicit Fixture(size_t budgetMb)
+        : repository(MemoryBudget{budgetMb * kMB, 0}, &metrics, [this](const std::string& spec) {
+            created++;
+            return createModel(spec);
+        })
+    {
+    }
+
+    //!
+    //! \brief Acquires a model and releases it right away, which makes it the most recently used.
+    //!
+    void touch(const std::string& name) {
+        CHECK(repository.acquire(name));
+    }
+
+    Metrics metrics;
+    std::atomic<int> created{0};
+    ModelRepository repository;
+};
+
+} // namespace
+
+TEST(loadsOnFirstUseOnly) {
+    Fixture f(0);
+    CHECK(f.repository.add("a", "sim:host_mb=10"));
+    CHECK(!f.repository.add("a", "sim"));
+    CHECK(!f.repository.isLoaded("a"));
+    CHECK_EQ(f.created.load(), 0);
+    f.touch("a");
+    f.touch("a");
+    CHECK(f.repository.isLoaded("a"));
+    CHECK_EQ(f.created.load(), 1);
+    CHECK_EQ(f.repository.stats().used.hostBytes, 10 * kMB);
+    CHECK(!f.repository.acquire("missing"));
+}
+
+TEST(evictsLeastRecentlyUsedFirst) {
+    Fixture f(250);
+    for (const char* name : {"a", "b", "c", "d"}) {
+        f.repository.add(name, "sim:host_mb=100");
+    }
+    f.touch("a");
+    f.touch("b");
+    f.touch("a"); // b is now the least recently used
+    f.touch("c");
+    CHECK(f.repository.isLoaded("a"));
+    CHECK(!f.repository.isLoaded("b"));
+    CHECK(f.repository.isLoaded("c"));
+
+    f.touch("d"); // a was used before c
+    CHECK(!f.repository.isLoaded("a"));
+    CHECK(f.repository.isLoaded("c"));
+    CHECK(f.repository.isLoaded("d"));
+
+    const auto stats = f.repository.stats();
+    CHECK_EQ(stats.loads, 4);
+    CHECK_EQ(stats.evictions, 2);
+    CHECK_EQ(stats.loaded, 2);
+}
+
+TEST(staysWithinBudget) {
+    Fixture f(300);
+    f.repository.add("small", "sim:host_mb=50");
+    f.repository.add("medium", "sim:host_mb=120");
+    f.repository.add("large", "sim:host_mb=200");
+    for (const char* name : {"small", "medium", "large", "small", "medium", "small", "large", "medium"}) {
+        f.touch(name);
+        CHECK(f.repository.stats().used.hostBytes <= 300 * kMB);
+        CHECK(f.repository.isLoaded(name));
+    }
+    // The metrics follow the repository's own accounting
+    std::string text;
+    f.metrics.render(text);
+    const std::string used = std::to_string(f.repository.stats().used.hostBytes);
+    CHECK(text.find("tensorrt_model_memory_bytes{kind=\"host\"} " + used + "\n") != std::string::npos);
+}
+
+TEST(leasedModelsAreNeverEvicted) {
+    Fixture f(250);
+    for (const char* name : {"a", "b", "c"}) {
+        f.repository.add(name, "sim:host_mb=100");
+    }
+    auto a = f.repository.acquire("a");
+    auto b = f.repository.acquire("b");
+    Model* modelA = a.get();
+
+    // Over budget, but every other loaded model is leased: c is loaded anyway and nothing is evicted
+    auto c = f.repository.acquire("c");
+    CHECK(c);
+    CHECK(f.repository.isLoaded("a"));
+    CHECK(f.repository.isLoaded("b"));
+    CHECK_EQ(f.repository.stats().used.hostBytes, 300 * kMB);
+    CHECK_EQ(f.repository.stats().evictions, 0);
+
+    // Releasing a lease makes that model evictable, and it goes at once since the budget is exceeded
+    b.reset();
+    CHECK(!f.repository.isLoaded("b"));
+    CHECK(f.repository.isLoaded("a"));
+    CHECK(f.repository.isLoaded("c"));
+    CHECK_EQ(f.repository.stats().used.hostBytes, 200 * kMB);
+    CHECK(a.get() == modelA);
+    char image[28 * 28] = {};
+    CHECK(a->infer(image) >= 0);
+}
+
+TEST(concurrentAcquiresShareOneLoad) {
+    Fixture f(0);
+    f.repository.add("slow", "sim:load_ms=200,host_mb=10");
+    std::vector<Model*> models(8, nullptr);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < models.size(); i++) {
+        threads.emplace_back([&f, &models, i]() {
+            auto lease = f.repository.acquire("slow");
+            models[i] = lease.get();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    CHECK_EQ(f.created.load(), 1);
+    CHECK_EQ(f.repository.stats().loads, 1);
+    for (Model* model : models) {
+        CHECK(model != nullptr);
+        CHECK(model == models[0]);
+    }
+}
+
+TEST(waitersOfAFailedLoadFailWithIt) {
+    Fixture f(0);
+    f.repository.add("broken", "sim:load_ms=100,fail_load=1");
+    std::atomic<int> failed{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&f, &failed]() {
+            if (!f.repository.acquire("broken")) {
+                failed++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    CHECK_EQ(failed.load(), 4);
+    CHECK_EQ(f.created.load(), 1);
+    CHECK_EQ(f.repository.stats().loadFailures, 1);
+    CHECK(!f.repository.isLoaded("broken"));
+
+    // A later request tries again
+    CHECK(!f.repository.acquire("broken"));
+    CHECK_EQ(f.created.load(), 2);
+}
+
+int main() {
+    return test::runAll();
+}
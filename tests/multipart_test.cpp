@@ -0,0 +1,96 @@
+//!
+//! MultipartReader and the helpers around it: parts come back in upload order, which /api/batch relies on for
+//! the order of its results, and malformed bodies are detected. Bodies are built by multipartBody() from the
+//! benchmark helpers.
+//!
+
+#include "bench.h"
+#include "multipart.h"
+#include "test.h"
+
+namespace {
+
+const char kBoundary[] = "----FormBoundaryXyZ";
+
+} // namespace
+
+TEST(partsComeInUploadOrder) {
+    std::vector<std::pair<std::string, std::string>> fields;
+    for (int i = 0; i < 50; i++) {
+        fields.emplace_back(i % 7 == 3 ? "label" : "file", "image " + std::to_string(i));
+    }
+    const std::string body = multipartBody(kBoundary, fields);
+
+    // What handleBatch does: collect the "file" parts
+    std::vector<std::string> files;
+    MultipartReader reader(body, kBoundary);
+    MultipartPart part;
+    while (reader.next(part)) {
+        if (part.name() == "file") {
+            files.emplace_back(part.body);
+        }
+    }
+    CHECK(!reader.failed());
+    std::vector<std::string> expected;
+    for (const auto& field : fields) {
+        if (field.first == "file") {
+            expected.push_back(field.second);
+        }
+    }
+    CHECK(files == expected);
+}
+
+TEST(findsPartHeadersAndParameters) {
+    const std::string body = multipartBody(kBoundary, {{"a", "1"}, {"file", "P5\r\n--Xy\r\nbinary"}, {"file", "second"}});
+    MultipartPart part;
+    CHECK(findMultipartPart(body, kBoundary, "file", part));
+    CHECK(part.body == "P5\r\n--Xy\r\nbinary");
+    std::string_view value;
+    CHECK(part.param("content-disposition", "filename", value) && value == "digit.pgm");
+    CHECK(part.header("Content-Type", value) && value == "application/octet-stream");
+    CHECK(!part.param("Content-Disposition", "nam", value));
+    CHECK(!findMultipartPart(body, kBoundary, "missing", part));
+}
+
+TEST(extractsTheBoundary) {
+    std::string_view boundary;
+    CHECK(multipartBoundary("multipart/form-data; boundary=abc", boundary) && boundary == "abc");
+    CHECK(multipartBoundary("Multipart/Form-Data;boundary=\"a b\"; charset=x", boundary) && boundary == "a b");
+    CHECK(!multipartBoundary("application/json", boundary));
+    CHECK(!multipartBoundary("multipart/form-data", boundary));
+    CHECK(!multipartBoundary("multipart/form-data; boundary=", boundary));
+}
+
+TEST(acceptsPreambleAndPartsWithoutHeaders) {
+    const std::string body = "preamble\r\n--B\r\n\r\nno headers\r\n--B  \r\n"
+                             "Content-Disposition: form-data; name=file\r\n\r\nX\r\n--B--";
+    MultipartReader reader(body, "B");
+    MultipartPart part;
+    CHECK(reader.next(part) && part.headers.empty() && part.body == "no headers");
+    CHECK(reader.next(part) && part.name() == "file" && part.body == "X");
+    CHECK(!reader.next(part));
+    CHECK(!reader.failed());
+}
+
+TEST(detectsMalformedBodies) {
+    const std::string body = multipartBody(kBoundary, {{"a", "1"}, {"file", "data"}, {"b", "2"}});
+    MultipartReader truncated(std::string_view(body).substr(0, body.size() - 20), kBoundary);
+    MultipartPart part;
+    int parts = 0;
+    while (truncated.next(part)) {
+        parts++;
+    }
+    CHECK_EQ(parts, 2);
+    CHECK(truncated.failed());
+
+    MultipartReader garbage("garbage", kBoundary);
+    CHECK(!garbage.next(part));
+    CHECK(garbage.failed());
+    MultipartReader noBoundary(body, "");
+    CHECK(!noBoundary.next(part));
+    CHECK(noBoundary.failed());
+}
+
+int main() {
+    return test::runAll();
+}
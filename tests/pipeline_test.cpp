@@ -0,0 +1,234 @@
+//!
+//! PipelineRegistry: loading and rejecting pipeline files, results of the CPU ops, and concurrent execution of
+//! independent branches. Models are SimulatedModel ("sim" backend), whose class is a hash of its input.
+//!
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include "pipeline.h"
+#include "sim_model.h"
+#include "test.h"
+
+namespace {
+
+const char kTwoDigits[] = R"(
+pipeline two_digits
+input 28 56
+node left   crop    input  x=0 y=0 w=28 h=28
+node right  crop    input  x=28 y=0 w=28 h=28
+node lprob  model   left   model=a
+node rprob  model   right  model=b
+node ldigit argmax  lprob
+node rdigit argmax  rprob
+node digits concat  ldigit rdigit
+output digits
+end
+
+pipeline probabilities
+input 28 56
+node left   crop    input  x=0 y=0 w=28 h=28
+node right  crop    input  x=28 y=0 w=28 h=28
+node lprob  model   left   model=a
+node rprob  model   right  model=b
+node both   concat  lprob rprob
+output both
+end
+)";
+
+std::vector<uint8_t> randomImage(int h, int w) {
+    std::mt19937 rng(3);
+    std::vector<uint8_t> image(static_cast<size_t>(h) * w);
+    for (auto& p : image) {
+        p = static_cast<uint8_t>(rng());
+    }
+    return image;
+}
+
+std::vector<uint8_t> cropImage(const std::vector<uint8_t>& image, int width, int x, int y, int w, int h) {
+    std::vector<uint8_t> out;
+    for (int r = 0; r < h; r++) {
+        const uint8_t* row = image.data() + static_cast<size_t>(y + r) * width + x;
+        out.insert(out.end(), row, row + w);
+    }
+    return out;
+}
+
+bool load(PipelineRegistry& registry, const std::string& text, std::string& error) {
+    const std::string path = test::writeTempFile("pipeline_test", text);
+    const bool loaded = registry.load(path, error);
+    std::remove(path.c_str());
+    return loaded;
+}
+
+//!
+//! \brief Loads kTwoDigits with models a and b taking latencyUs per image.
+//!
+void loadTwoDigits(PipelineRegistry& registry, int64_t latencyUs) {
+    const std::string sim = "sim:per_item_us=0,latency_us=" + std::to_string(latencyUs);
+    std::string error;
+    CHECK(load(registry, "model a " + sim + "\nmodel b " + sim + "\n" + kTwoDigits, error));
+    CHECK_EQ(error, "");
+}
+
+//!
+//! \brief SimulatedModel whose calls wait until `parties` of them are in flight at once, or until a timeout.
+//!        Calls that run one after the other time out, so met() tells whether they overlapped without relying
+//!        on how long anything took.
+//!
+class RendezvousModel : public SimulatedModel {
+public:
+    RendezvousModel(int parties, std::chrono::milliseconds timeout)
+        : SimulatedModel(params())
+        , mParties(parties)
+        , mTimeout(timeout)
+    {
+    }
+
+    int inferProbabilities(const char* data, float* probabilities) override {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mArrived++;
+            mAllArrived.notify_all();
+            if (!mAllArrived.wait_for(lock, mTimeout, [this]() { return mArrived >= mParties; })) {
+                mTimedOut = true;
+            }
+        }
+        return SimulatedModel::inferProbabilities(data, probabilities);
+    }
+
+    bool met() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mArrived >= mParties && !mTimedOut;
+    }
+
+private:
+    static SimulatedModelParams params() {
+        SimulatedModelParams p;
+        p.latencyUs = 0;
+        p.perItemUs = 0;
+        return p;
+    }
+
+    const int mParties;
+    const std::chrono::milliseconds mTimeout;
+    std::mutex mMutex;
+    std::condition_variable mAllArrived;
+    int mArrived{0};
+    bool mTimedOut{false};
+};
+
+//!
+//! \brief Runs two_digits with both model nodes served by a RendezvousModel, and returns whether they overlapped.
+//!
+bool branchesOverlap(int threads, std::chrono::milliseconds timeout) {
+    RendezvousModel model(2, timeout);
+    model.load();
+    PipelineRegistry registry(threads);
+    registry.addModel("a", &model);
+    registry.addModel("b", &model);
+    std::string error;
+    CHECK(load(registry, kTwoDigits, error));
+    const auto image = randomImage(28, 56);
+    const Tensor out = registry.run(*registry.find("two_digits"), image.data());
+    CHECK(out.shape == std::vector<int>{2});
+    return model.met();
+}
+
+} // namespace
+
+TEST(concatOfArgmaxGivesEachDigit) {
+    const auto image = randomImage(28, 56);
+    SimulatedModel reference;
+    const int left = reference.infer(reinterpret_cast<const char*>(cropImage(image, 56, 0, 0, 28, 28).data()));
+    const int right = reference.infer(reinterpret_cast<const char*>(cropImage(image, 56, 28, 0, 28, 28).data()));
+
+    for (int threads : {0, 2}) {
+        PipelineRegistry registry(threads);
+        loadTwoDigits(registry, 0);
+        const Pipeline* pipeline = registry.find("two_digits");
+        CHECK(pipeline != nullptr);
+        if (!pipeline) {
+            continue;
+        }
+        CHECK_EQ(pipeline->inputH(), 28);
+        CHECK_EQ(pipeline->inputW(), 56);
+        const Tensor out = registry.run(*pipeline, image.data());
+        CHECK(out.shape == std::vector<int>{2});
+        CHECK(out.data == (std::vector<float>{static_cast<float>(left), static_cast<float>(right)}));
+    }
+}
+
+TEST(concatHandsOffWholeTensorsInInputOrder) {
+    const auto image = randomImage(28, 56);
+    SimulatedModel reference;
+    const int left = reference.infer(reinterpret_cast<const char*>(cropImage(image, 56, 0, 0, 28, 28).data()));
+    const int right = reference.infer(reinterpret_cast<const char*>(cropImage(image, 56, 28, 0, 28, 28).data()));
+
+    PipelineRegistry registry(2);
+    loadTwoDigits(registry, 0);
+    const Tensor out = registry.run(*registry.find("probabilities"), image.data());
+    CHECK(out.shape == std::vector<int>{20});
+    std::vector<float> expected(20, 0.0F);
+    expected[left] = 1.0F;
+    expected[10 + right] = 1.0F;
+    CHECK(out.data == expected);
+}
+
+TEST(independentBranchesRunConcurrently) {
+    // The two model nodes only meet if they run on different pool threads at the same time. The timeout just
+    // bounds how long a broken scheduler makes the test hang; run sequentially, the calls can never meet.
+    CHECK(branchesOverlap(2, std::chrono::seconds(30)));
+    CHECK(!branchesOverlap(0, std::chrono::milliseconds(10)));
+}
+
+TEST(namesListsEveryPipeline) {
+    PipelineRegistry registry(0);
+    loadTwoDigits(registry, 0);
+    CHECK(registry.names() == (std::vector<std::string>{"probabilities", "two_digits"}));
+    CHECK(registry.find("missing") == nullptr);
+}
+
+TEST(rejectsCyclesAndMalformedPipelines) {
+    const std::string header = "model a sim:latency_us=0\npipeline p\ninput 28 28\n";
+    const std::vector<std::pair<std::string, std::string>> cases = {
+        // A node can only read nodes declared above it, so neither a cycle nor a self loop can be written
+        {"node x argmax y\nnode y argmax x\noutput y\nend\n", "node y is not defined above"},
+        {"node x concat x\noutput x\nend\n", "node x is not defined above"},
+        {"node x crop input x=0 y=0 w=28 h=28\nnode x argmax input\noutput x\nend\n", "node x already defined"},
+        {"node x blur input\noutput x\nend\n", "unknown op blur"},
+        {"node x crop input x=0 y=0 w=28\noutput x\nend\n", "crop requires h"},
+        {"node x crop input x=0 y=0 w=28 h=28 depth=2\noutput x\nend\n", "crop has no parameter depth"},
+        {"node x crop input x=1 y=0 w=28 h=28\noutput x\nend\n", "crop window does not fit input [28,28]"},
+        {"node x crop input x=0 y=0 w=14 h=28\nnode m model x model=a\noutput m\nend\n",
+            "model a takes 784 pixels, input is [28,14]"},
+        {"node m model input model=b\noutput m\nend\n", "unknown model b"},
+        {"node x argmax input\noutput x\nend\n", "argmax needs a 1-D input, got [28,28]"},
+        {"node x crop input input x=0 y=0 w=28 h=28\noutput x\nend\n", "crop takes one input"},
+        {"node m model input model=a\noutput n\nend\n", "expected: output <defined node>"},
+        {"node m model input model=a\nend\n", "pipeline p needs an input and an output"},
+        {"node m model input model=a\noutput m\n", "missing end of pipeline p"},
+    };
+    for (const auto& c : cases) {
+        PipelineRegistry registry(0);
+        std::string error;
+        const bool loaded = load(registry, header + c.first, error);
+        CHECK(!loaded);
+        if (error.find(c.second) == std::string::npos) {
+            test::fail(__FILE__, __LINE__, "error \"" + error + "\" should contain \"" + c.second + "\"");
+        }
+        CHECK(registry.find("p") == nullptr);
+    }
+
+    PipelineRegistry registry(0);
+    std::string error;
+    CHECK(!load(registry, "pipeline p\nnode x argmax input\nend\n", error));
+    CHECK(error.find(":2: input must come before the nodes") != std::string::npos);
+    CHECK(!registry.load("/nonexistent/pipelines.txt", error));
+}
+
+int main() {
+    return test::runAll();
+}
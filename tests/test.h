@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+//!
+//! Minimal test harness shared by the tests in this directory: a test is a function registered with TEST, and
+//! CHECK records a failure without stopping the test. main() returns runAll(), which is non-zero if any
+//! check failed; that is what ctest looks at.
+//!
+
+namespace test {
+
+struct Case {
+    const char* name;
+    std::function<void()> fn;
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> all;
+    return all;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Register {
+    Register(const char* name, std::function<void()> fn) {
+        cases().push_back({name, std::move(fn)});
+    }
+};
+
+inline void fail(const char* file, int line, const std::string& what) {
+    std::cout << "  " << file << ":" << line << ": CHECK failed: " << what << std::endl;
+    failures()++;
+}
+
+//!
+//! \brief Runs every registered test and returns the exit code for main().
+//!
+inline int runAll() {
+    for (const auto& c : cases()) {
+        const int before = failures();
+        c.fn();
+        std::cout << (failures() == before ? "[ ok ] " : "[FAIL] ") << c.name << std::endl;
+    }
+    std::cout << cases().size() << " tests, " << failures() << " failed checks" << std::endl;
+    return failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//!
+//! \brief Writes text to a file in the temporary directory, unique to this process, and returns its path.
+//!
+inline std::string writeTempFile(const std::string& name, const std::string& text) {
+    const char* dir = std::getenv("TMPDIR");
+    const std::string path = std::string(dir ? dir : "/tmp") + "/" + name + "." + std::to_string(getpid());
+    std::ofstream(path) << text;
+    return path;
+}
+
+} // namespace test
+
+#define TEST_CONCAT_(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_(a, b)
+#define TEST(name)                                                                                                    \
+    static void name();                                                                                               \
+    static test::Register TEST_CONCAT(register_, name)(#name, name);                                                  \
+    static void name()
+
+#define CHECK(condition)                                                                                              \
+    do {                                                                                                              \
+        if (!(condition)) {                                                                                           \
+            test::fail(__FILE__, __LINE__, #condition);                                                               \
+        }                                                                                                             \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                                \
+    do {                                                                                                              \
+        const auto& checkA = (a);                                                                                     \
+        const auto& checkB = (b);                                                                                     \
+        if (!(checkA == checkB)) {                                                                                    \
+            std::ostringstream what;                                                                                  \
+            what << #a " == " #b " (" << checkA << " vs " << checkB << ")";                                           \
+            test::fail(__FILE__, __LINE__, what.str());                                                               \
+        }                                                                                                             \
+    } while (0)